@@ -4,24 +4,45 @@ CONFIG -= app_bundle
 CONFIG -= qt
 
 SOURCES += \
+        biglightsout.cpp \
         lightsout.cpp \
         main.cpp \
+        mappedfile.cpp \
         mmz.cpp \
+        mmzbatch.cpp \
+        mmzgenerator.cpp \
         move.cpp \
         optsolver.cpp \
+        parallel.cpp \
         position.cpp \
+        positiontable.cpp \
         puzzle.cpp \
+        slabpool.cpp \
         solver.cpp \
         ternary.cpp \
-        toh.cpp
+        toh.cpp \
+        tohsolver.cpp
 
 HEADERS += \
+    biglightsout.h \
+    bitboard.h \
+    csrgraph.h \
     lightsout.h \
+    lightsoutsolver.h \
+    mappedfile.h \
     mmz.h \
+    mmzbatch.h \
+    mmzgenerator.h \
     move.h \
     optsolver.h \
+    parallel.h \
     position.h \
+    positiontable.h \
     puzzle.h \
+    slabpool.h \
     solver.h \
+    statemap.h \
     ternary.h \
-    toh.h
+    toh.h \
+    tohsolver.h \
+    valuesolver.h
@@ -0,0 +1,157 @@
+#include "biglightsout.h"
+#include <iostream>
+#include <sstream>
+
+/* class BigLightsOutPosition */
+
+BigLightsOutPosition::BigLightsOutPosition(const Bitboard &board) : board(board) {}
+
+const Bitboard &BigLightsOutPosition::getBoard() const {
+    return this->board;
+}
+
+void BigLightsOutPosition::setBoard(const Bitboard &board) {
+    this->board = board;
+}
+
+BigLightsOutPosition::~BigLightsOutPosition() {}
+
+std::size_t BigLightsOutPosition::hash() const {
+    return this->board.hash();
+}
+
+bool BigLightsOutPosition::operator ==(const Position &other) const {
+    const BigLightsOutPosition *otherPtr = static_cast<const BigLightsOutPosition *>(&other);
+    return this->board == otherPtr->board;
+}
+
+Position *BigLightsOutPosition::getCopy() const {
+    return new BigLightsOutPosition(this->board);
+}
+
+/* class BigLightsOut */
+
+BigLightsOut::BigLightsOut(std::size_t rows, std::size_t cols) {
+    if (rows == 0 || cols == 0) {
+        std::cout << "Grid cannot be empty. Falling back on default values.\n";
+        rows = cols = 10;
+    }
+    if (rows > Bitboard::BITS || cols > Bitboard::BITS || rows * cols > Bitboard::BITS) {
+        std::cout << "Grid dimensions cannot exceed " << Bitboard::BITS << " cells in total."
+                     " Falling back on default values.\n";
+        rows = cols = 10;
+    }
+    this->rows = rows;
+    this->cols = cols;
+    this->masks.resize(rows * cols);
+    for (std::size_t i = 0; i < rows; ++i) {
+        for (std::size_t j = 0; j < cols; ++j) {
+            Bitboard &mask = this->masks[i * cols + j];
+            mask.set(i * cols + j);
+            if (j > 0) {
+                mask.set(i * cols + j - 1);
+            }
+            if (j < cols - 1) {
+                mask.set(i * cols + j + 1);
+            }
+            if (i > 0) {
+                mask.set((i - 1) * cols + j);
+            }
+            if (i < rows - 1) {
+                mask.set((i + 1) * cols + j);
+            }
+        }
+    }
+}
+
+BigLightsOut::~BigLightsOut() {}
+
+std::size_t BigLightsOut::getRows() const {
+    return this->rows;
+}
+
+std::size_t BigLightsOut::getCols() const {
+    return this->cols;
+}
+
+Bitboard BigLightsOut::initialState() const {
+    return Bitboard();
+}
+
+bool BigLightsOut::isPrimitiveState(const Bitboard &state) const {
+    return state == Bitboard();
+}
+
+/**
+ * @brief Every cell can be pressed in every position.
+ */
+std::size_t BigLightsOut::stateMoves(const Bitboard &state, MoveCode *moves) const {
+    (void)state; // Unused.
+    std::size_t numMoves = this->rows * this->cols;
+    for (std::size_t k = 0; k < numMoves; ++k) {
+        moves[k] = static_cast<MoveCode>(k);
+    }
+    return numMoves;
+}
+
+std::size_t BigLightsOut::maxMoves() const {
+    return this->rows * this->cols;
+}
+
+std::string BigLightsOut::moveString(MoveCode move) const {
+    return LightsOutMove(move / this->cols, move % this->cols).toString();
+}
+
+Position *BigLightsOut::getInitialPosition() const {
+    return new BigLightsOutPosition(initialState());
+}
+
+bool BigLightsOut::isPrimitivePosition(const Position *pos) const {
+    return isPrimitiveState(static_cast<const BigLightsOutPosition *>(pos)->getBoard());
+}
+
+std::vector<Move *> BigLightsOut::getMoves(const Position *pos) const {
+    (void)pos; // Unused.
+    std::vector<Move *> moves;
+    for (std::size_t i = 0; i < this->rows; ++i) {
+        for (std::size_t j = 0; j < this->cols; ++j) {
+            moves.push_back(new LightsOutMove(i, j));
+        }
+    }
+    return moves;
+}
+
+Position *BigLightsOut::doMove(const Position *pos_, const Move *move_) const {
+    const BigLightsOutPosition *pos = static_cast<const BigLightsOutPosition *>(pos_);
+    const LightsOutMove *move = static_cast<const LightsOutMove *>(move_);
+    std::size_t i = move->get_i();
+    std::size_t j = move->get_j();
+    if (i >= this->rows || j >= this->cols) {
+        /* Invalid move. */
+        return new BigLightsOutPosition(pos->getBoard());
+    }
+    return new BigLightsOutPosition(applyMove(pos->getBoard(), static_cast<MoveCode>(i * this->cols + j)));
+}
+
+std::size_t BigLightsOut::getMoveCodes(const Position *pos, MoveCode *moves) const {
+    return stateMoves(static_cast<const BigLightsOutPosition *>(pos)->getBoard(), moves);
+}
+
+void BigLightsOut::doMove(const Position *pos, MoveCode move, Position *child) const {
+    const Bitboard &board = static_cast<const BigLightsOutPosition *>(pos)->getBoard();
+    static_cast<BigLightsOutPosition *>(child)->setBoard(applyMove(board, move));
+}
+
+Puzzle *BigLightsOut::getCopy() const {
+    return new BigLightsOut(*this);
+}
+
+std::size_t BigLightsOut::hashSize() const {
+    return 0;
+}
+
+std::string BigLightsOut::getId() const {
+    std::stringstream ss;
+    ss << "biglightsout " << this->rows << ' ' << this->cols;
+    return ss.str();
+}
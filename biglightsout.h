@@ -0,0 +1,76 @@
+#ifndef BIGLIGHTSOUT_H
+#define BIGLIGHTSOUT_H
+#include "bitboard.h"
+#include "lightsout.h"
+#include <vector>
+
+/**
+ * @brief Position of a Lights Out board of up to Bitboard::BITS cells.
+ * Cell (i, j) of a board with COLS columns is bit i * COLS + j.
+ */
+class BigLightsOutPosition : public Position {
+private:
+    Bitboard board;
+
+public:
+    BigLightsOutPosition(const Bitboard &board = Bitboard());
+    const Bitboard &getBoard() const;
+    void setBoard(const Bitboard &board);
+
+    // Position interface
+    virtual ~BigLightsOutPosition() override;
+    virtual std::size_t hash() const override;
+    virtual bool operator ==(const Position &other) const override;
+    virtual Position *getCopy() const override;
+};
+
+/**
+ * @brief Lights Out on boards larger than the 64 cells LightsOut is
+ * limited to. Moves are LightsOutMoves, and the move code of cell (i, j)
+ * is i * cols + j as in LightsOut. A move XORs a precomputed plus-shaped
+ * mask into the board.
+ *
+ * The game graph has 2^(rows * cols) positions, so boards of this size
+ * are meant to be solved with LightsOutSolver rather than by BFS.
+ */
+class BigLightsOut : public Puzzle {
+private:
+    std::size_t rows;
+    std::size_t cols;
+    /* Cells toggled by pressing each cell. */
+    std::vector<Bitboard> masks;
+
+public:
+    BigLightsOut(std::size_t rows = 10, std::size_t cols = 10);
+
+    std::size_t getRows() const;
+    std::size_t getCols() const;
+
+    // State interface (see valuesolver.h), with Bitboard states.
+    Bitboard initialState() const;
+    bool isPrimitiveState(const Bitboard &state) const;
+    std::size_t stateMoves(const Bitboard &state, MoveCode *moves) const;
+    Bitboard applyMove(const Bitboard &state, MoveCode move) const;
+    virtual std::size_t maxMoves() const override;
+    virtual std::string moveString(MoveCode move) const override;
+
+    // Puzzle interface
+    virtual ~BigLightsOut() override;
+    virtual Position *getInitialPosition() const override;
+    virtual bool isPrimitivePosition(const Position *pos) const override;
+    virtual std::vector<Move *> getMoves(const Position *pos) const override;
+    virtual Position *doMove(const Position *pos, const Move *move) const override;
+    virtual std::size_t getMoveCodes(const Position *pos, MoveCode *moves) const override;
+    virtual void doMove(const Position *pos, MoveCode move, Position *child) const override;
+    virtual Puzzle *getCopy() const override;
+    virtual std::size_t hashSize() const override;
+    virtual std::string getId() const override;
+};
+
+inline Bitboard BigLightsOut::applyMove(const Bitboard &state, MoveCode move) const {
+    Bitboard child = state;
+    child ^= this->masks[move];
+    return child;
+}
+
+#endif // BIGLIGHTSOUT_H
@@ -0,0 +1,201 @@
+#ifndef BITBOARD_H
+#define BITBOARD_H
+#include "statemap.h"
+#include <cstddef>
+#include <cstdint>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/**
+ * @brief Fixed-size set of up to BITS bits stored in 64-bit words.
+ *
+ * XOR and comparison run on 256-bit AVX2 or 128-bit SSE2 registers when
+ * the compiler targets them, and on single words otherwise.
+ */
+struct Bitboard {
+    const static std::size_t WORDS = 8;
+    const static std::size_t BITS = WORDS * 64;
+
+    std::uint64_t words[WORDS];
+
+    Bitboard() : words() {}
+
+    bool test(std::size_t i) const {
+        return (this->words[i >> 6] >> (i & 63)) & 1;
+    }
+
+    void set(std::size_t i) {
+        this->words[i >> 6] |= std::uint64_t(1) << (i & 63);
+    }
+
+    Bitboard &operator ^=(const Bitboard &other) {
+#if defined(__AVX2__)
+        for (std::size_t i = 0; i < WORDS; i += 4) {
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(this->words + i));
+            __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(other.words + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(this->words + i), _mm256_xor_si256(a, b));
+        }
+#elif defined(__SSE2__)
+        for (std::size_t i = 0; i < WORDS; i += 2) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(this->words + i));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(other.words + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(this->words + i), _mm_xor_si128(a, b));
+        }
+#else
+        for (std::size_t i = 0; i < WORDS; ++i) {
+            this->words[i] ^= other.words[i];
+        }
+#endif
+        return *this;
+    }
+
+    bool operator ==(const Bitboard &other) const {
+#if defined(__AVX2__)
+        __m256i diff = _mm256_setzero_si256();
+        for (std::size_t i = 0; i < WORDS; i += 4) {
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(this->words + i));
+            __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(other.words + i));
+            diff = _mm256_or_si256(diff, _mm256_xor_si256(a, b));
+        }
+        return _mm256_testz_si256(diff, diff);
+#elif defined(__SSE2__)
+        __m128i diff = _mm_setzero_si128();
+        for (std::size_t i = 0; i < WORDS; i += 2) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(this->words + i));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(other.words + i));
+            diff = _mm_or_si128(diff, _mm_xor_si128(a, b));
+        }
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(diff, _mm_setzero_si128())) == 0xffff;
+#else
+        std::uint64_t diff = 0;
+        for (std::size_t i = 0; i < WORDS; ++i) {
+            diff |= this->words[i] ^ other.words[i];
+        }
+        return diff == 0;
+#endif
+    }
+
+    bool operator !=(const Bitboard &other) const {
+        return !(*this == other);
+    }
+
+    std::uint64_t hash() const {
+        std::uint64_t h = 0;
+        for (std::size_t i = 0; i < WORDS; ++i) {
+            h = (h ^ this->words[i]) * 0x9e3779b97f4a7c15ULL;
+        }
+        return mixHash(h);
+    }
+};
+
+/**
+ * @brief Writes VALUE ^ MASKS[i] into OUT[i] for all i < N, several words
+ * per instruction where SIMD is available.
+ */
+inline void xorBroadcast(std::uint64_t value, const std::uint64_t *masks, std::size_t n,
+                         std::uint64_t *out) {
+    std::size_t i = 0;
+#if defined(__AVX2__)
+    __m256i v = _mm256_set1_epi64x(static_cast<long long>(value));
+    for (; i + 4 <= n; i += 4) {
+        __m256i m = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(masks + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), _mm256_xor_si256(v, m));
+    }
+#elif defined(__SSE2__)
+    __m128i v = _mm_set1_epi64x(static_cast<long long>(value));
+    for (; i + 2 <= n; i += 2) {
+        __m128i m = _mm_loadu_si128(reinterpret_cast<const __m128i *>(masks + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_xor_si128(v, m));
+    }
+#endif
+    for (; i < n; ++i) {
+        out[i] = value ^ masks[i];
+    }
+}
+
+/* Bit operations shared by std::uint64_t and Bitboard boards, so that
+ * board algorithms can be written once for both. */
+
+inline bool testBit(std::uint64_t board, std::size_t i) {
+    return (board >> i) & 1;
+}
+
+inline bool testBit(const Bitboard &board, std::size_t i) {
+    return board.test(i);
+}
+
+inline void setBit(std::uint64_t &board, std::size_t i) {
+    board |= std::uint64_t(1) << i;
+}
+
+inline void setBit(Bitboard &board, std::size_t i) {
+    board.set(i);
+}
+
+inline std::uint64_t getWord(std::uint64_t board, std::size_t w) {
+    (void)w; // Unused.
+    return board;
+}
+
+inline std::uint64_t getWord(const Bitboard &board, std::size_t w) {
+    return board.words[w];
+}
+
+inline void setWord(std::uint64_t &board, std::size_t w, std::uint64_t word) {
+    (void)w; // Unused.
+    board = word;
+}
+
+inline void setWord(Bitboard &board, std::size_t w, std::uint64_t word) {
+    board.words[w] = word;
+}
+
+inline int popCount(std::uint64_t board) {
+    return __builtin_popcountll(board);
+}
+
+inline int popCount(const Bitboard &board) {
+    int count = 0;
+    for (std::size_t i = 0; i < Bitboard::WORDS; ++i) {
+        count += __builtin_popcountll(board.words[i]);
+    }
+    return count;
+}
+
+/**
+ * @brief Returns the parity of the number of bits set in both A and B,
+ * their inner product over GF(2).
+ */
+inline bool dotParity(std::uint64_t a, std::uint64_t b) {
+    return __builtin_parityll(a & b);
+}
+
+inline bool dotParity(const Bitboard &a, const Bitboard &b) {
+    std::uint64_t x = 0;
+    for (std::size_t i = 0; i < Bitboard::WORDS; ++i) {
+        x ^= a.words[i] & b.words[i];
+    }
+    return __builtin_parityll(x);
+}
+
+/**
+ * @brief Transposes the 64x64 bit matrix whose row i is ROWS[i], so that
+ * bit j of ROWS[i] moves to bit i of ROWS[j].
+ */
+inline void transpose64(std::uint64_t *rows) {
+    std::uint64_t mask = 0x00000000ffffffffULL;
+    for (std::size_t j = 32; j != 0; j >>= 1, mask ^= mask << j) {
+        /* Swap the upper-left and lower-right J x J blocks of every
+         * 2J x 2J block on the diagonal. */
+        for (std::size_t k = 0; k < 64; k = ((k | j) + 1) & ~j) {
+            std::uint64_t t = ((rows[k] >> j) ^ rows[k | j]) & mask;
+            rows[k] ^= t << j;
+            rows[k | j] ^= t;
+        }
+    }
+}
+
+#endif // BITBOARD_H
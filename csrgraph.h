@@ -0,0 +1,109 @@
+#ifndef CSRGRAPH_H
+#define CSRGRAPH_H
+#include <cstddef>
+#include <vector>
+
+/**
+ * @brief Directed graph over dense node indices in compressed sparse row
+ * form.
+ *
+ * The successors of node i are stored contiguously from
+ * targets[offsets[i]] up to targets[offsets[i + 1]]. INDEX is the type of
+ * a node index; using std::uint32_t halves the size of the graph whenever
+ * the number of nodes allows it.
+ *
+ * The graph is built in two passes over the edges:
+ *     graph.reset(numNodes);
+ *     for every edge (from, to): graph.countEdge(from);
+ *     graph.allocate();
+ *     for every edge (from, to): graph.addEdge(from, to);
+ *     graph.finish();
+ */
+template <class Index>
+class CsrGraph {
+private:
+    std::vector<std::size_t> offsets;
+    std::vector<Index> targets;
+
+public:
+    CsrGraph();
+
+    void reset(std::size_t numNodes);
+    void countEdge(std::size_t from);
+    void allocate();
+    void addEdge(std::size_t from, Index to);
+    void finish();
+    void clear();
+
+    std::size_t numNodes() const;
+    std::size_t numEdges() const;
+    const Index *begin(std::size_t node) const;
+    const Index *end(std::size_t node) const;
+};
+
+template <class Index>
+CsrGraph<Index>::CsrGraph() : offsets(1, 0) {}
+
+template <class Index>
+void CsrGraph<Index>::reset(std::size_t numNodes) {
+    this->offsets.assign(numNodes + 1, 0);
+    this->targets.clear();
+}
+
+template <class Index>
+inline void CsrGraph<Index>::countEdge(std::size_t from) {
+    ++this->offsets[from + 1];
+}
+
+template <class Index>
+void CsrGraph<Index>::allocate() {
+    /* Turn the counts into the start of each row. */
+    for (std::size_t i = 1; i < this->offsets.size(); ++i) {
+        this->offsets[i] += this->offsets[i - 1];
+    }
+    this->targets.resize(this->offsets.back());
+    /* offsets[i + 1] is used as the fill cursor of row i until finish(). */
+    for (std::size_t i = this->offsets.size() - 1; i > 0; --i) {
+        this->offsets[i] = this->offsets[i - 1];
+    }
+}
+
+template <class Index>
+inline void CsrGraph<Index>::addEdge(std::size_t from, Index to) {
+    this->targets[this->offsets[from + 1]++] = to;
+}
+
+template <class Index>
+void CsrGraph<Index>::finish() {
+    /* Every cursor has now reached the end of its row, which is the start
+     * of the next one. */
+    this->offsets[0] = 0;
+}
+
+template <class Index>
+void CsrGraph<Index>::clear() {
+    std::vector<std::size_t>(1, 0).swap(this->offsets);
+    std::vector<Index>().swap(this->targets);
+}
+
+template <class Index>
+std::size_t CsrGraph<Index>::numNodes() const {
+    return this->offsets.size() - 1;
+}
+
+template <class Index>
+std::size_t CsrGraph<Index>::numEdges() const {
+    return this->targets.size();
+}
+
+template <class Index>
+inline const Index *CsrGraph<Index>::begin(std::size_t node) const {
+    return this->targets.data() + this->offsets[node];
+}
+
+template <class Index>
+inline const Index *CsrGraph<Index>::end(std::size_t node) const {
+    return this->targets.data() + this->offsets[node + 1];
+}
+
+#endif // CSRGRAPH_H
@@ -1,4 +1,5 @@
 #include "lightsout.h"
+#include "bitboard.h"
 #include <iostream>
 #include <sstream>
 
@@ -10,6 +11,10 @@ std::size_t LightsOutPosition::getPos() const {
     return this->pos;
 }
 
+void LightsOutPosition::setPos(std::size_t pos) {
+    this->pos = pos;
+}
+
 LightsOutPosition::~LightsOutPosition() {}
 
 std::size_t LightsOutPosition::hash() const {
@@ -58,17 +63,39 @@ LightsOut::LightsOut(std::size_t rows, std::size_t cols) {
     }
     this->rows = rows;
     this->cols = cols;
+    this->masks.assign(rows * cols, 0);
+    std::uint64_t one = 1;
+    for (std::size_t i = 0; i < rows; ++i) {
+        for (std::size_t j = 0; j < cols; ++j) {
+            std::size_t move = i * cols + j;
+            /* Toggle light at center cell. */
+            std::uint64_t mask = one << move;
+            /* Toggle left cell if possible. */
+            mask |= j > 0 ? one << (move - 1) : 0;
+            /* Toggle right cell if possible. */
+            mask |= j < cols - 1 ? one << (move + 1) : 0;
+            /* Toggle top cell if possible. */
+            mask |= i > 0 ? one << (move - cols) : 0;
+            /* Toggle bottom cell if possible. */
+            mask |= i < rows - 1 ? one << (move + cols) : 0;
+            this->masks[move] = mask;
+        }
+    }
 }
 
 LightsOut::~LightsOut() {}
 
+std::string LightsOut::moveString(MoveCode move) const {
+    return LightsOutMove(move / this->cols, move % this->cols).toString();
+}
+
 Position *LightsOut::getInitialPosition() const {
-    return new LightsOutPosition;
+    return new LightsOutPosition(initialState());
 }
 
 bool LightsOut::isPrimitivePosition(const Position *pos_) const {
     const LightsOutPosition *pos = static_cast<const LightsOutPosition *>(pos_);
-    return pos->hash() == 0;
+    return isPrimitiveState(pos->getPos());
 }
 
 std::vector<Move *> LightsOut::getMoves(const Position *pos) const {
@@ -87,22 +114,19 @@ Position *LightsOut::doMove(const Position *pos_, const Move *move_) const {
     const LightsOutMove *move = static_cast<const LightsOutMove *>(move_);
     std::size_t i = move->get_i();
     std::size_t j = move->get_j();
-    std::size_t newPos = pos->getPos();
     if (i >= this->rows || j >= this->cols) {
         /* Invalid move. */
-        return new LightsOutPosition(newPos);
+        return new LightsOutPosition(pos->getPos());
     }
-    /* Toggle light at center cell. */
-    newPos ^= std::size_t(1) << (i * this->cols + j);
-    /* Toggle left cell if possible. */
-    newPos ^= (std::size_t(1) << (i * this->cols + j - 1)) * (j > 0);
-    /* Toggle right cell if possible. */
-    newPos ^= (std::size_t(1) << (i * this->cols + j + 1)) * (j < this->cols - 1);
-    /* Toggle top cell if possible. */
-    newPos ^= (std::size_t(1) << ((i - 1) * this->cols + j)) * (i > 0);
-    /* Toggle bottom cell if possible. */
-    newPos ^= (std::size_t(1) << ((i + 1) * this->cols + j)) * (i < this->rows - 1);
-    return new LightsOutPosition(newPos);
+    return new LightsOutPosition(applyMove(pos->getPos(), static_cast<MoveCode>(i * this->cols + j)));
+}
+
+std::size_t LightsOut::getMoveCodes(const Position *pos, MoveCode *moves) const {
+    return stateMoves(static_cast<const LightsOutPosition *>(pos)->getPos(), moves);
+}
+
+void LightsOut::doMove(const Position *pos, MoveCode move, Position *child) const {
+    static_cast<LightsOutPosition *>(child)->setPos(applyMove(static_cast<const LightsOutPosition *>(pos)->getPos(), move));
 }
 
 Puzzle *LightsOut::getCopy() const {
@@ -112,3 +136,36 @@ Puzzle *LightsOut::getCopy() const {
 std::size_t LightsOut::hashSize() const {
     return std::size_t(1) << (this->rows * this->cols);
 }
+
+bool LightsOut::hasInjectiveHash() const {
+    return true;
+}
+
+bool LightsOut::isReversible() const {
+    /* Every move undoes itself. */
+    return true;
+}
+
+std::string LightsOut::getId() const {
+    std::stringstream ss;
+    ss << "lightsout " << this->rows << ' ' << this->cols;
+    return ss.str();
+}
+
+bool LightsOut::unhash(std::size_t hash, Position *pos) const {
+    static_cast<LightsOutPosition *>(pos)->setPos(hash);
+    return true;
+}
+
+/**
+ * @brief Every cell can be pressed in every position, so the children of
+ * a board are the board XORed with each toggle mask.
+ */
+bool LightsOut::expandHashes(const std::uint64_t *hashes, std::size_t count,
+                             std::uint64_t *children) const {
+    std::size_t numMoves = this->masks.size();
+    for (std::size_t p = 0; p < count; ++p) {
+        xorBroadcast(hashes[p], this->masks.data(), numMoves, children + p * numMoves);
+    }
+    return true;
+}
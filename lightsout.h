@@ -9,6 +9,7 @@ private:
 public:
     LightsOutPosition(std::size_t pos = 0);
     std::size_t getPos() const;
+    void setPos(std::size_t pos);
 
     // Position interface
     virtual ~LightsOutPosition() override;
@@ -36,18 +37,74 @@ class LightsOut : public Puzzle {
 private:
     std::size_t rows;
     std::size_t cols;
+    /* Cells toggled by pressing each cell. */
+    std::vector<std::uint64_t> masks;
 
 public:
     LightsOut(std::size_t rows = 3, std::size_t cols = 3);
 
+    // State interface (see valuesolver.h)
+    std::uint64_t initialState() const;
+    bool isPrimitiveState(std::uint64_t state) const;
+    virtual std::size_t maxMoves() const override;
+    std::size_t stateMoves(std::uint64_t state, MoveCode *moves) const;
+    std::uint64_t applyMove(std::uint64_t state, MoveCode move) const;
+    std::uint64_t canonicalState(std::uint64_t state) const;
+    virtual std::string moveString(MoveCode move) const override;
+
     // Puzzle interface
     virtual ~LightsOut() override;
     virtual Position *getInitialPosition() const override;
     virtual bool isPrimitivePosition(const Position *pos_) const override;
     virtual std::vector<Move *> getMoves(const Position *pos) const override;
     virtual Position *doMove(const Position *pos_, const Move *move_) const override;
+    virtual std::size_t getMoveCodes(const Position *pos, MoveCode *moves) const override;
+    virtual void doMove(const Position *pos, MoveCode move, Position *child) const override;
     virtual Puzzle *getCopy() const override;
     virtual std::size_t hashSize() const override;
+    virtual bool hasInjectiveHash() const override;
+    virtual bool isReversible() const override;
+    virtual std::string getId() const override;
+    virtual bool unhash(std::size_t hash, Position *pos) const override;
+    virtual bool expandHashes(const std::uint64_t *hashes, std::size_t count,
+                              std::uint64_t *children) const override;
 };
 
+inline std::uint64_t LightsOut::initialState() const {
+    return 0;
+}
+
+inline bool LightsOut::isPrimitiveState(std::uint64_t state) const {
+    return state == 0;
+}
+
+inline std::size_t LightsOut::maxMoves() const {
+    return this->rows * this->cols;
+}
+
+/**
+ * @brief Every cell can be pressed in every position. The move code
+ * of cell (i, j) is i * cols + j.
+ */
+inline std::size_t LightsOut::stateMoves(std::uint64_t state, MoveCode *moves) const {
+    (void)state; // Unused.
+    std::size_t numMoves = this->rows * this->cols;
+    for (std::size_t k = 0; k < numMoves; ++k) {
+        moves[k] = static_cast<MoveCode>(k);
+    }
+    return numMoves;
+}
+
+inline std::uint64_t LightsOut::applyMove(std::uint64_t state, MoveCode move) const {
+    return state ^ this->masks[move];
+}
+
+/**
+ * @brief Reflections and rotations of the board are not reduced, so every
+ * state is canonical.
+ */
+inline std::uint64_t LightsOut::canonicalState(std::uint64_t state) const {
+    return state;
+}
+
 #endif // LIGHTSOUT_H
@@ -0,0 +1,342 @@
+#ifndef LIGHTSOUTSOLVER_H
+#define LIGHTSOUTSOLVER_H
+#include "biglightsout.h"
+#include "bitboard.h"
+#include "lightsout.h"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Solves Lights Out boards as linear systems over GF(2).
+ *
+ * Pressing cells commutes and pressing a cell twice undoes it, so a set
+ * of presses X (bit k set if cell k is pressed) turns board B off exactly
+ * when A X = B, where column k of the toggle matrix A is the set of cells
+ * toggled by cell k. The constructor row-reduces A once, recording the
+ * row operations, with one bit per cell so that a row update is a single
+ * XOR of two boards. Afterwards:
+ *
+ * - B is solvable if it is orthogonal to every recorded row operation
+ *   that reduced a row of A to zero.
+ * - One solution is read off the recorded row operations at the pivots.
+ * - All solutions are that one plus a vector of the null space of A, and
+ *   the minimum number of presses is found by walking the null space in
+ *   Gray code order, which takes 2^nullity() steps.
+ *
+ * The minimum number of presses equals the remoteness of B from the
+ * all-off board computed by OptSolver and Solver.
+ *
+ * solveBatch() answers many queries at once with the boards bit-sliced:
+ * word c of a slice holds cell c of 64 boards, one board per bit, so each
+ * XOR or AND above serves 64 boards. Press counts are kept as bit-sliced
+ * binary counters and compared lane by lane.
+ *
+ * GAME is LightsOut with std::uint64_t boards or BigLightsOut with
+ * Bitboard boards; it must provide maxMoves() and applyMove(BOARD,
+ * MoveCode).
+ */
+template <typename Game, typename Board>
+class BasicLightsOutSolver {
+private:
+    std::size_t numCells;
+    /* Row operations leading to each pivot, and the pivot's cell. */
+    std::vector<Board> pivotOps;
+    std::vector<std::size_t> pivotCells;
+    /* Row operations that reduce A to zero rows. */
+    std::vector<Board> consistencyOps;
+    /* Basis of the null space of A. */
+    std::vector<Board> nullBasis;
+
+public:
+    BasicLightsOutSolver(const Game &puzzle);
+
+    std::size_t nullity() const;
+    bool isSolvable(const Board &board) const;
+
+    /**
+     * @brief Writes a smallest set of presses that turns BOARD off into
+     * PRESSES and returns its size. Returns -1 if BOARD is unsolvable.
+     */
+    int solve(const Board &board, Board &presses) const;
+
+    /**
+     * @brief Returns the minimum number of presses that turns BOARD off,
+     * or -1 if BOARD is unsolvable.
+     */
+    int minPresses(const Board &board) const;
+
+    /**
+     * @brief Solves the COUNT boards in BOARDS. Writes the minimum number
+     * of presses of BOARDS[i], or -1 if it is unsolvable, into RMTS[i] and,
+     * unless PRESSES is null, a smallest set of presses that turns it off
+     * into PRESSES[i], or an empty set if it is unsolvable.
+     */
+    void solveBatch(const Board *boards, std::size_t count, int *rmts, Board *presses) const;
+
+    /**
+     * @brief Same as above for an array of positions of GAME.
+     */
+    template <typename PositionType>
+    void solveBatch(const PositionType *const *positions, std::size_t count, int *rmts, Board *presses) const;
+
+private:
+    void solveLanes(const Board *boards, std::size_t count, int *rmts, Board *presses,
+                    std::vector<std::uint64_t> &buffer) const;
+};
+
+typedef BasicLightsOutSolver<LightsOut, std::uint64_t> LightsOutSolver;
+typedef BasicLightsOutSolver<BigLightsOut, Bitboard> BigLightsOutSolver;
+
+inline std::uint64_t positionBoard(const LightsOutPosition *pos) {
+    return pos->getPos();
+}
+
+inline const Bitboard &positionBoard(const BigLightsOutPosition *pos) {
+    return pos->getBoard();
+}
+
+template <typename Game, typename Board>
+BasicLightsOutSolver<Game, Board>::BasicLightsOutSolver(const Game &puzzle) {
+    this->numCells = puzzle.maxMoves();
+    /* Row i of A is the set of cells whose press toggles cell i. A is
+     * symmetric, so that is the set of cells toggled by pressing i. Each
+     * row is paired with the row operations that produced it, starting
+     * from the identity. */
+    std::vector<Board> rows(this->numCells);
+    std::vector<Board> ops(this->numCells);
+    for (std::size_t i = 0; i < this->numCells; ++i) {
+        rows[i] = puzzle.applyMove(Board(), static_cast<MoveCode>(i));
+        ops[i] = Board();
+        setBit(ops[i], i);
+    }
+
+    /* Gauss-Jordan elimination. */
+    std::size_t rank = 0;
+    std::vector<bool> isPivot(this->numCells, false);
+    for (std::size_t col = 0; col < this->numCells && rank < this->numCells; ++col) {
+        std::size_t pivot = rank;
+        while (pivot < this->numCells && !testBit(rows[pivot], col)) {
+            ++pivot;
+        }
+        if (pivot == this->numCells) {
+            continue;
+        }
+        std::swap(rows[pivot], rows[rank]);
+        std::swap(ops[pivot], ops[rank]);
+        for (std::size_t i = 0; i < this->numCells; ++i) {
+            if (i != rank && testBit(rows[i], col)) {
+                rows[i] ^= rows[rank];
+                ops[i] ^= ops[rank];
+            }
+        }
+        isPivot[col] = true;
+        this->pivotCells.push_back(col);
+        ++rank;
+    }
+    this->pivotOps.assign(ops.begin(), ops.begin() + rank);
+    this->consistencyOps.assign(ops.begin() + rank, ops.end());
+
+    /* Every free cell gives one null space vector: press the free cell
+     * and every pivot cell whose reduced row contains it. */
+    for (std::size_t col = 0; col < this->numCells; ++col) {
+        if (isPivot[col]) {
+            continue;
+        }
+        Board vec = Board();
+        setBit(vec, col);
+        for (std::size_t i = 0; i < rank; ++i) {
+            if (testBit(rows[i], col)) {
+                setBit(vec, this->pivotCells[i]);
+            }
+        }
+        this->nullBasis.push_back(vec);
+    }
+}
+
+template <typename Game, typename Board>
+std::size_t BasicLightsOutSolver<Game, Board>::nullity() const {
+    return this->nullBasis.size();
+}
+
+template <typename Game, typename Board>
+bool BasicLightsOutSolver<Game, Board>::isSolvable(const Board &board) const {
+    for (const Board &op : this->consistencyOps) {
+        if (dotParity(op, board)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename Game, typename Board>
+int BasicLightsOutSolver<Game, Board>::solve(const Board &board, Board &presses) const {
+    if (!isSolvable(board)) {
+        return -1;
+    }
+    /* With all free cells unpressed, pivot cell i is pressed exactly when
+     * the board transformed by its row operations has its bit set. */
+    Board curr = Board();
+    for (std::size_t i = 0; i < this->pivotOps.size(); ++i) {
+        if (dotParity(this->pivotOps[i], board)) {
+            setBit(curr, this->pivotCells[i]);
+        }
+    }
+    presses = curr;
+    int best = popCount(curr);
+    std::uint64_t numCombinations = std::uint64_t(1) << this->nullBasis.size();
+    for (std::uint64_t g = 1; g < numCombinations; ++g) {
+        /* Consecutive Gray codes differ in the lowest set bit of G. */
+        curr ^= this->nullBasis[__builtin_ctzll(g)];
+        int count = popCount(curr);
+        if (count < best) {
+            best = count;
+            presses = curr;
+        }
+    }
+    return best;
+}
+
+template <typename Game, typename Board>
+int BasicLightsOutSolver<Game, Board>::minPresses(const Board &board) const {
+    Board presses;
+    return solve(board, presses);
+}
+
+template <typename Game, typename Board>
+void BasicLightsOutSolver<Game, Board>::solveBatch(const Board *boards, std::size_t count,
+                                                   int *rmts, Board *presses) const {
+    std::vector<std::uint64_t> buffer;
+    for (std::size_t i = 0; i < count; i += 64) {
+        std::size_t lanes = count - i < 64 ? count - i : 64;
+        solveLanes(boards + i, lanes, rmts + i, presses ? presses + i : nullptr, buffer);
+    }
+}
+
+template <typename Game, typename Board>
+template <typename PositionType>
+void BasicLightsOutSolver<Game, Board>::solveBatch(const PositionType *const *positions, std::size_t count,
+                                                   int *rmts, Board *presses) const {
+    std::vector<Board> boards(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        boards[i] = positionBoard(positions[i]);
+    }
+    solveBatch(boards.data(), count, rmts, presses);
+}
+
+/**
+ * @brief Solves at most 64 boards, one per bit lane, using BUFFER as
+ * scratch space.
+ */
+template <typename Game, typename Board>
+void BasicLightsOutSolver<Game, Board>::solveLanes(const Board *boards, std::size_t count, int *rmts, Board *presses,
+                                                   std::vector<std::uint64_t> &buffer) const {
+    std::size_t numWords = (this->numCells + 63) / 64;
+    std::size_t numSlices = numWords * 64;
+    /* Enough counter bits to count every cell. */
+    std::size_t counterBits = 1;
+    while ((std::size_t(1) << counterBits) <= this->numCells) {
+        ++counterBits;
+    }
+    buffer.assign(3 * numSlices + 2 * counterBits, 0);
+    std::uint64_t *slices = buffer.data();
+    std::uint64_t *curr = slices + numSlices;
+    std::uint64_t *best = curr + numSlices;
+    std::uint64_t *currCount = best + numSlices;
+    std::uint64_t *bestCount = currCount + counterBits;
+
+    /* Slice the boards, 64 cells at a time. */
+    for (std::size_t w = 0; w < numWords; ++w) {
+        std::uint64_t *block = slices + w * 64;
+        for (std::size_t lane = 0; lane < count; ++lane) {
+            block[lane] = getWord(boards[lane], w);
+        }
+        transpose64(block);
+    }
+    /* XOR of the slices of the cells in OP, i.e. the parity of OP & B for
+     * every board B. */
+    auto sliceParity = [&](const Board &op) {
+        std::uint64_t parity = 0;
+        for (std::size_t w = 0; w < numWords; ++w) {
+            for (std::uint64_t word = getWord(op, w); word; word &= word - 1) {
+                parity ^= slices[w * 64 + __builtin_ctzll(word)];
+            }
+        }
+        return parity;
+    };
+    auto countPresses = [&]() {
+        std::fill(currCount, currCount + counterBits, 0);
+        for (std::size_t c = 0; c < this->numCells; ++c) {
+            std::uint64_t carry = curr[c];
+            for (std::size_t j = 0; carry && j < counterBits; ++j) {
+                std::uint64_t next = currCount[j] & carry;
+                currCount[j] ^= carry;
+                carry = next;
+            }
+        }
+    };
+
+    std::uint64_t unsolvable = 0;
+    for (const Board &op : this->consistencyOps) {
+        unsolvable |= sliceParity(op);
+    }
+    for (std::size_t i = 0; i < this->pivotOps.size(); ++i) {
+        curr[this->pivotCells[i]] = sliceParity(this->pivotOps[i]);
+    }
+    countPresses();
+    std::copy(curr, curr + numSlices, best);
+    std::copy(currCount, currCount + counterBits, bestCount);
+    /* Unused lanes hold empty boards, which are solvable. */
+    std::uint64_t numCombinations = ~unsolvable ? std::uint64_t(1) << this->nullBasis.size() : 1;
+    for (std::uint64_t g = 1; g < numCombinations; ++g) {
+        /* Every board adds the same null space vector. */
+        const Board &vec = this->nullBasis[__builtin_ctzll(g)];
+        for (std::size_t w = 0; w < numWords; ++w) {
+            for (std::uint64_t word = getWord(vec, w); word; word &= word - 1) {
+                curr[w * 64 + __builtin_ctzll(word)] ^= ~std::uint64_t(0);
+            }
+        }
+        countPresses();
+        /* Lanes whose count is below the best so far, found by comparing
+         * the counters from the most significant bit down. */
+        std::uint64_t less = 0;
+        std::uint64_t equal = ~std::uint64_t(0);
+        for (std::size_t j = counterBits; j-- > 0;) {
+            less |= equal & ~currCount[j] & bestCount[j];
+            equal &= ~(currCount[j] ^ bestCount[j]);
+        }
+        if (!less) {
+            continue;
+        }
+        for (std::size_t j = 0; j < counterBits; ++j) {
+            bestCount[j] ^= (bestCount[j] ^ currCount[j]) & less;
+        }
+        for (std::size_t c = 0; c < this->numCells; ++c) {
+            best[c] ^= (best[c] ^ curr[c]) & less;
+        }
+    }
+
+    for (std::size_t lane = 0; lane < count; ++lane) {
+        int rmt = 0;
+        for (std::size_t j = 0; j < counterBits; ++j) {
+            rmt |= int((bestCount[j] >> lane) & 1) << j;
+        }
+        rmts[lane] = (unsolvable >> lane) & 1 ? -1 : rmt;
+    }
+    if (presses) {
+        for (std::size_t lane = 0; lane < count; ++lane) {
+            presses[lane] = Board();
+        }
+        for (std::size_t w = 0; w < numWords; ++w) {
+            std::uint64_t *block = best + w * 64;
+            transpose64(block);
+            for (std::size_t lane = 0; lane < count; ++lane) {
+                if (!((unsolvable >> lane) & 1)) {
+                    setWord(presses[lane], w, block[lane]);
+                }
+            }
+        }
+    }
+}
+
+#endif // LIGHTSOUTSOLVER_H
@@ -1,18 +1,28 @@
 #include "mmz.h"
+#include "mmzbatch.h"
+#include "mmzgenerator.h"
 #include "solver.h"
 #include "toh.h"
 #include "optsolver.h"
 #include "lightsout.h"
+#include "lightsoutsolver.h"
 #include "ternary.h"
+#include "slabpool.h"
 #include <chrono>
 #include <iostream>
 
 using namespace std;
 
 const char *fileName = "./res/mmz/ra_13.maze";
+const char *dbFileName = "./lightsout_6x6.db";
+const char *mazeDirName = "./res/mmz";
 
 void solve(const MMz &mmz, bool verbose);
 void timeSolve();
+void timeBatchQueries();
+void batchSolve();
+void convertMaze(const char *mazeFileName, const char *binaryFileName);
+void generateLevels();
 void debugPlay();
 
 int main()
@@ -22,7 +32,12 @@ int main()
 //    solver.solve();
 //    solver.printInfo(cout, true);
 
-    OptSolver solver(&t);
+    OptSolver solver(&t, OptSolver::MOD3);
+    /* Reuse the database of an earlier run if there is one. */
+    if (!solver.loadData(dbFileName)) {
+        solver.solve();
+        solver.saveData(dbFileName);
+    }
     cout << solver.solve() << endl;
     bool done = false;
     std::size_t pos;
@@ -35,7 +50,6 @@ int main()
         LightsOutPosition p(pos);
         solver.printShortestPathFrom(&p, cout);
     }
-//    solver.saveData("test.bin");
     return 0;
 }
 
@@ -50,6 +64,7 @@ void solve(const MMz &mmz, bool verbose) {
 
 void timeSolve() {
     MMz mmz(fileName);
+    SlabStats before = slabStats();
     auto t1 = std::chrono::high_resolution_clock::now();
     for (int i = 0; i < 1000; ++i) {
         solve(mmz, false);
@@ -69,6 +84,61 @@ void timeSolve() {
     std::cout << "solve() took " << fp_ms.count() << " ms, "
               << "or " << int_ms.count() << " whole milliseconds "
               << "(which is " << int_usec.count() << " whole microseconds)" << std::endl;
+
+    SlabStats after = slabStats();
+    std::cout << "positions and moves allocated per solve(): "
+              << (after.allocations - before.allocations) / 1000
+              << ", slabs in use: " << after.slabs << std::endl;
+}
+
+void timeBatchQueries() {
+    LightsOut lo(6, 6);
+    LightsOutSolver solver(lo);
+    std::vector<std::uint64_t> boards(1 << 20);
+    std::uint64_t state = 88172645463325252ULL;
+    for (std::uint64_t &board : boards) {
+        /* xorshift64 */
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        board = state & (lo.hashSize() - 1);
+    }
+    std::vector<int> rmts(boards.size());
+    std::vector<std::uint64_t> presses(boards.size());
+    auto t1 = std::chrono::high_resolution_clock::now();
+    solver.solveBatch(boards.data(), boards.size(), rmts.data(), presses.data());
+    auto t2 = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> seconds = t2 - t1;
+    std::cout << "solved " << boards.size() << " boards in " << seconds.count() << " s ("
+              << boards.size() / seconds.count() << " per second)" << std::endl;
+}
+
+void batchSolve() {
+    /* One thread per hardware thread and at most 1 GiB per maze. */
+    MMzBatch batch(0, std::size_t(1) << 30);
+    batch.addPath(mazeDirName);
+    batch.run();
+    batch.writeCsv(cout);
+    batch.printSummary(cout);
+}
+
+void convertMaze(const char *mazeFileName, const char *binaryFileName) {
+    MMz mmz;
+    if (!mmz.readFromFile(mazeFileName) || !mmz.saveBinary(binaryFileName)) {
+        cout << "cannot convert " << mazeFileName << " to " << binaryFileName << endl;
+    }
+}
+
+void generateLevels() {
+    /* One thread per hardware thread, a white mummy and a trap. */
+    MMzGenerator generator(6, 6);
+    generator.setNumTraps(1);
+    generator.run(64);
+    for (const MMzLevel &level : generator.getLevels()) {
+        cout << "remoteness " << level.remoteness << ", " << level.numPositions << " positions\n"
+             << level.text << endl;
+    }
+    generator.printSummary(cout);
 }
 
 void debugPlay() {
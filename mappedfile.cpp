@@ -0,0 +1,94 @@
+#include "mappedfile.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() {
+    this->base = nullptr;
+    this->length = 0;
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+#ifdef _WIN32
+bool MappedFile::open(const std::string &filename) {
+    close();
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (mapping == NULL) {
+        return false;
+    }
+    /* The view keeps the mapping alive after its handle is closed. */
+    void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (view == NULL) {
+        return false;
+    }
+    this->base = static_cast<const char *>(view);
+    this->length = static_cast<std::size_t>(size.QuadPart);
+    return true;
+}
+
+void MappedFile::close() {
+    if (this->base) {
+        UnmapViewOfFile(this->base);
+        this->base = nullptr;
+        this->length = 0;
+    }
+}
+#else
+bool MappedFile::open(const std::string &filename) {
+    close();
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1 || st.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+    /* The mapping stays valid after the descriptor is closed. */
+    void *view = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED) {
+        return false;
+    }
+    this->base = static_cast<const char *>(view);
+    this->length = static_cast<std::size_t>(st.st_size);
+    return true;
+}
+
+void MappedFile::close() {
+    if (this->base) {
+        munmap(const_cast<char *>(this->base), this->length);
+        this->base = nullptr;
+        this->length = 0;
+    }
+}
+#endif
+
+const char *MappedFile::data() const {
+    return this->base;
+}
+
+std::size_t MappedFile::size() const {
+    return this->length;
+}
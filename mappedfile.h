@@ -0,0 +1,35 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+#include <cstddef>
+#include <string>
+
+/**
+ * @brief Read-only memory mapping of a whole file.
+ *
+ * The mapping is shared, so processes mapping the same file share its
+ * pages in the page cache, and pages are only read from disk when they
+ * are first touched.
+ */
+class MappedFile {
+private:
+    const char *base;
+    std::size_t length;
+
+public:
+    MappedFile();
+    MappedFile(const MappedFile &other) = delete;
+    MappedFile &operator =(const MappedFile &other) = delete;
+    ~MappedFile();
+
+    /**
+     * @brief Maps FILENAME, replacing any previous mapping. Returns false
+     * if the file cannot be opened or is empty.
+     */
+    bool open(const std::string &filename);
+    void close();
+
+    const char *data() const;
+    std::size_t size() const;
+};
+
+#endif // MAPPEDFILE_H
@@ -1,13 +1,13 @@
 #include "mmz.h"
+#include "statemap.h"
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <fstream>
 #include <limits>
 #include <sstream>
 
 namespace {
-const std::uint64_t ONE = 1;
-const std::uint64_t MAX_NPCS = 4;
-const std::uint64_t PLAYER_IDX = MAX_NPCS;
 const std::uint64_t PLAYER_STRENGTH = 4;
 const std::uint64_t INVALID_LOC = std::numeric_limits<uint64_t>::max();
 
@@ -24,11 +24,14 @@ const std::uint64_t INVALID_LOC = std::numeric_limits<uint64_t>::max();
  * +-------+----------------------+
  *    10    9                     0
  *
- * Structure of a position:
+ * Structure of a position with MAX_NPCS = 4 in 64 bits:
  * +------+-------------+--------------+--------------+--------------+--------------+
  * | Gate | Player info |  NPC 3 info  |  NPC 2 info  |  NPC 1 info  |  NPC 0 info  |
  * +------+-------------+--------------+--------------+--------------+--------------+
  *    63   62         52 51          39 38          26 25          13 12           0
+ *
+ * With MAX_NPCS = 8 in 128 bits, NPC infos 4 to 7 follow NPC 3 info, so
+ * that the player info starts at bit 104 and the gate is bit 115.
  */
 const std::size_t CHARACTER_LOC_LENGTH     = 10;
 const std::size_t CHARACTER_ALIVE_SHIFT    = CHARACTER_LOC_LENGTH;
@@ -39,14 +42,49 @@ const std::size_t CHARACTER_INFO_LENGTH    = CHARACTER_WALKING_SHIFT + 1;
 const std::size_t PLAYER_INFO_LENGTH       = CHARACTER_ALIVE_SHIFT + 1;
 
 /* Only position and alive masks are valid for player. */
-const std::uint64_t CHARACTER_LOC_MASK      = (ONE << CHARACTER_LOC_LENGTH) - 1;
-const std::uint64_t CHARACTER_ALIVE_MASK    = ONE << CHARACTER_ALIVE_SHIFT;
-const std::uint64_t CHARACTER_COLOR_MASK    = ONE << CHARACTER_COLOR_SHIFT;
-const std::uint64_t CHARACTER_WALKING_MASK  = ONE << CHARACTER_WALKING_SHIFT;
-const std::uint64_t CHARACTER_STRENGTH_MASK = CHARACTER_COLOR_MASK | CHARACTER_WALKING_MASK;
-
-const std::size_t   GATE_SHIFT = MAX_NPCS * CHARACTER_INFO_LENGTH + PLAYER_INFO_LENGTH;
-const std::uint64_t GATE_MASK  = ONE << GATE_SHIFT;
+const std::uint64_t CHARACTER_LOC_MASK      = (std::uint64_t(1) << CHARACTER_LOC_LENGTH) - 1;
+const std::uint64_t CHARACTER_STRENGTH_MASK = 3;
+const std::uint64_t CHARACTER_INFO_MASK     = (std::uint64_t(1) << CHARACTER_INFO_LENGTH) - 1;
+
+/* Positions of the player info and the gate bit in a STATE. */
+template <class State>
+struct Layout {
+    const static std::size_t PLAYER_IDX = MMzStateTraits<State>::MAX_NPCS;
+    const static std::size_t GATE_SHIFT = PLAYER_IDX * CHARACTER_INFO_LENGTH + PLAYER_INFO_LENGTH;
+};
+
+/* The single state that stands for every state in which the player is
+ * dead. */
+const std::uint64_t DEAD_STATE = 0;
+
+/* Binary maze layout, in native byte order:
+ *     MazeHeader,
+ *     ROWS * COLS CellRecord entries of 4 bytes, row by row,
+ *     zero padding up to CHASEOFFSET,
+ *     the chase table of 4 * (ROWS * COLS)^2 16-bit entries.
+ * The chase table is used straight from a mapping of the file, so it
+ * starts on an 8-byte boundary. */
+const char MAZE_MAGIC[8] = {'P', 'Z', 'S', 'O', 'L', 'V', 'M', 'Z'};
+const std::uint32_t MAZE_VERSION = 1;
+const std::uint32_t MAZE_BYTE_ORDER = 0x01020304;
+
+struct MazeHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byteOrder;
+    /* MAX_NPCS of the state type, which fixes the layout of INITPOS. */
+    std::uint32_t maxNPCs;
+    std::uint32_t rows;
+    std::uint32_t cols;
+    std::uint32_t reserved;
+    /* Initial state, low word first. */
+    std::uint64_t initPos[2];
+    std::uint64_t chaseOffset;
+};
+
+inline std::uint64_t chaseOffset(std::uint64_t numCells) {
+    return (sizeof(MazeHeader) + numCells * 4 + 7) / 8 * 8;
+}
 
 const char EMPTY         = '_';
 const char WALL          = 'W';
@@ -62,7 +100,7 @@ const char RED_MMY       = '3';  // converts to 0b11
 const char PLAYER        = '4';
 
 /* Helper Functions */
-inline void setBit(std::uint64_t &number, std::size_t n, bool x);
+template <class State> inline void setBit(State &number, std::size_t n, bool x);
 inline std::size_t toWorldDim(std::size_t gridDim);
 inline std::size_t toGridDim(std::size_t worldDim);
 std::size_t toWorldLoc(std::uint64_t gridLoc, std::size_t gridCols);
@@ -73,57 +111,76 @@ inline bool isKey(char c);
 inline bool isGate(char c);
 inline bool isExit(char c);
 inline bool isTrap(char c);
-
-inline void chrSetAlive(std::uint64_t &pos, std::uint64_t chrIdx);
-inline void chrSetLoc(std::uint64_t &pos, std::uint64_t loc, std::uint64_t chrIdx);
-inline void chrSetStrength(std::uint64_t &pos, std::uint64_t strength, std::uint64_t chrIdx);
-bool addChr(std::uint64_t &pos, char chr, std::uint64_t loc);
-inline void killChr(std::uint64_t &pos, std::size_t chrIdx);
-inline void killPlayer(std::uint64_t &pos);
-bool collect(std::uint64_t &pos);
-void setGate(std::uint64_t &pos, char gate);
-void setGate(std::uint64_t &pos, bool closed);
-void toggleGate(std::uint64_t &pos);
-
-uint64_t moveChr(std::uint64_t &pos, std::size_t chrIdx, int direction, std::size_t gridCols);
-std::uint64_t movePlayer(std::uint64_t &pos, int direction, std::size_t gridCols);
-
-inline bool gateIsClosed(std::uint64_t pos);
-inline std::uint64_t chrLoc(std::uint64_t pos, std::size_t chrIdx);
-inline bool chrIsAlive(std::uint64_t pos, std::size_t chrIdx);
-inline bool chrIsWalking(std::uint64_t pos, std::size_t chrIdx);
-inline bool chrIsRed(std::uint64_t pos, std::size_t chrIdx);
-inline std::uint64_t chrStrength(std::uint64_t pos, std::size_t chrIdx);
-inline std::uint64_t playerLoc(std::uint64_t pos);
-inline bool playerIsAlive(std::uint64_t pos);
+bool readNumber(const char *&p, const char *end, std::size_t &n);
+inline void toWords(std::uint64_t state, std::uint64_t *words);
+inline void toWords(Uint128 state, std::uint64_t *words);
+inline void fromWords(const std::uint64_t *words, std::uint64_t &state);
+inline void fromWords(const std::uint64_t *words, Uint128 &state);
+inline std::uint64_t stateHash(std::uint64_t state);
+inline std::uint64_t stateHash(Uint128 state);
+
+template <class State> inline void chrSetAlive(State &pos, std::size_t chrIdx);
+template <class State> inline void chrSetLoc(State &pos, std::uint64_t loc, std::size_t chrIdx);
+template <class State> inline void chrSetStrength(State &pos, std::uint64_t strength, std::size_t chrIdx);
+template <class State> inline void chrSetInfo(State &pos, std::uint64_t info, std::size_t chrIdx);
+template <class State> bool addChr(State &pos, char chr, std::uint64_t loc);
+template <class State> inline void killChr(State &pos, std::size_t chrIdx);
+template <class State> void setGate(State &pos, char gate);
+template <class State> void setGate(State &pos, bool closed);
+template <class State> void toggleGate(State &pos);
+
+template <class State> inline State npcLanes(std::size_t shift);
+template <class State> inline State npcsAt(State pos, std::uint64_t loc);
+inline std::size_t lowestBit(std::uint64_t bits);
+inline std::size_t lowestBit(Uint128 bits);
+
+template <class State> inline bool gateIsClosed(State pos);
+template <class State> inline std::uint64_t chrLoc(State pos, std::size_t chrIdx);
+template <class State> inline bool chrIsAlive(State pos, std::size_t chrIdx);
+template <class State> inline std::uint64_t chrStrength(State pos, std::size_t chrIdx);
+template <class State> inline std::uint64_t chrInfo(State pos, std::size_t chrIdx);
+template <class State> inline std::uint64_t playerLoc(State pos);
+template <class State> inline bool playerIsAlive(State pos);
 
 void getOffsets(int direction, int &i_ofs, int &j_ofs);
 } // Anonymous Namespace
 
-/* class MMzPosition */
+/* class BasicMMzPosition */
 
-inline MMzPosition::MMzPosition(std::uint64_t pos) {
+template <class State>
+BasicMMzPosition<State>::BasicMMzPosition(State pos, std::uint64_t hashValue) {
     this->pos = pos;
+    this->hashValue = hashValue;
 }
 
-inline MMzPosition::~MMzPosition() {}
+template <class State>
+BasicMMzPosition<State>::~BasicMMzPosition() {}
 
-inline uint64_t MMzPosition::getPos() const {
+template <class State>
+State BasicMMzPosition<State>::getPos() const {
     return this->pos;
 }
 
-inline std::size_t MMzPosition::hash() const {
-    assert(sizeof(std::size_t) == sizeof(std::uint64_t));
-    return this->pos;
+template <class State>
+void BasicMMzPosition<State>::setPos(State pos, std::uint64_t hashValue) {
+    this->pos = pos;
+    this->hashValue = hashValue;
+}
+
+template <class State>
+std::size_t BasicMMzPosition<State>::hash() const {
+    return this->hashValue;
 }
 
-inline bool MMzPosition::operator ==(const Position &other_) const {
-    const MMzPosition *other = static_cast<const MMzPosition *>(&other_);
+template <class State>
+bool BasicMMzPosition<State>::operator ==(const Position &other_) const {
+    const BasicMMzPosition *other = static_cast<const BasicMMzPosition *>(&other_);
     return this->pos == other->pos;
 }
 
-inline Position *MMzPosition::getCopy() const {
-    return new MMzPosition(this->pos);
+template <class State>
+Position *BasicMMzPosition<State>::getCopy() const {
+    return new BasicMMzPosition(this->pos, this->hashValue);
 }
 
 /* class MMzMove */
@@ -166,76 +223,332 @@ std::string MMzMove::toString() const {
     }
 }
 
-/* class MMz */
+/* class BasicMMz */
 
-inline MMz::MMz() {
+/**
+ * @brief Walls, gates and items of a cell as stored in binary maze files.
+ * Bit d of WALLS and GATES is set if a wall or a gate lies in direction d.
+ */
+template <class State>
+struct BasicMMz<State>::CellRecord {
+    std::uint8_t walls;
+    std::uint8_t gates;
+    /* TRAP_CELL, KEY_CELL and EXIT_CELL flags. */
+    std::uint8_t flags;
+    std::uint8_t reserved;
+};
+
+template <class State>
+BasicMMz<State>::BasicMMz() {
     this->initialized = false;
+    this->rows = 0;
+    this->cols = 0;
+    this->initPos = 0;
+    this->numNPCs = 0;
+    this->numCells = 0;
+    this->cells = nullptr;
+    this->chase = nullptr;
+    this->numOpenCells = 0;
+    this->openCells = nullptr;
+    this->cellIndex = nullptr;
+    this->gateStates = 1;
+    this->numRanks = 0;
+    this->twins = 0;
 }
 
-MMz::MMz(const std::string &fileName) {
+template <class State>
+BasicMMz<State>::BasicMMz(const std::string &fileName) : BasicMMz() {
     readFromFile(fileName);
 }
 
-inline MMz::~MMz() {}
+template <class State>
+BasicMMz<State>::~BasicMMz() {}
 
-bool MMz::readFromFile(const std::string &fileName) {
+/**
+ * @brief Reads the maze in FILENAME, which is either in the text format
+ * of res/mmz or in the binary format written by saveBinary(). Returns
+ * false if the file cannot be read or does not hold a valid maze.
+ */
+template <class State>
+bool BasicMMz<State>::readFromFile(const std::string &fileName) {
     this->initialized = false;
-    std::ifstream fin;
-    fin.open(fileName);
-    if (!fin.is_open()) {
+    std::shared_ptr<MappedFile> file(new MappedFile);
+    if (!file->open(fileName)) {
         return false;
     }
-    fin >> this->rows;
-    fin >> this->cols;
-    this->worldRows = toWorldDim(this->rows);
-    this->worldCols = toWorldDim(this->cols);
-    world.resize(worldRows * worldCols);
-    this->initPos = 0;
-    fin.get();
-    for (std::size_t i = 0; i < this->worldRows; ++i) {
-        for (std::size_t j = 0; j < this->worldCols; ++j) {
-            std::size_t loc = i * this->worldCols + j;
-            fin.get(world[loc]);
+    std::vector<CellRecord> records;
+    State pos = 0;
+    bool isBinary = file->size() >= sizeof(MAZE_MAGIC) &&
+            std::memcmp(file->data(), MAZE_MAGIC, sizeof(MAZE_MAGIC)) == 0;
+    if (isBinary) {
+        const std::uint16_t *chase;
+        if (!parseBinary(file->data(), file->size(), records, pos, chase)) {
+            return false;
+        }
+        /* The tables keep the file mapped for the chase table. */
+        return load(pos, records, file, chase);
+    } else if (!parseText(file->data(), file->size(), records, pos)) {
+        return false;
+    }
+    return load(pos, records, nullptr, nullptr);
+}
+
+/**
+ * @brief Reads a maze in the text format from TEXT. Returns false if
+ * TEXT does not hold a valid maze.
+ */
+template <class State>
+bool BasicMMz<State>::readFromString(const std::string &text) {
+    this->initialized = false;
+    std::vector<CellRecord> records;
+    State pos = 0;
+    if (!parseText(text.data(), text.size(), records, pos)) {
+        return false;
+    }
+    return load(pos, records, nullptr, nullptr);
+}
+
+/**
+ * @brief Writes the maze to FILENAME in the binary format. Returns false
+ * if the maze is not initialized or the file cannot be written.
+ */
+template <class State>
+bool BasicMMz<State>::saveBinary(const std::string &fileName) const {
+    if (!this->initialized) {
+        return false;
+    }
+    MazeHeader header = MazeHeader();
+    std::memcpy(header.magic, MAZE_MAGIC, sizeof(header.magic));
+    header.version = MAZE_VERSION;
+    header.byteOrder = MAZE_BYTE_ORDER;
+    header.maxNPCs = MAX_NPCS;
+    header.rows = static_cast<std::uint32_t>(this->rows);
+    header.cols = static_cast<std::uint32_t>(this->cols);
+    toWords(this->initPos, header.initPos);
+    header.chaseOffset = chaseOffset(this->numCells);
+    std::vector<CellRecord> records(this->numCells, CellRecord());
+    for (std::size_t loc = 0; loc < this->numCells; ++loc) {
+        const Cell &cell = this->cells[loc];
+        for (int direction = 0; direction < MMzMove::NUM_POSSIBLE_MOVES; ++direction) {
+            if (cell.dest[direction] == NO_CELL) {
+                records[loc].walls |= 1 << direction;
+            }
+        }
+        records[loc].gates = cell.gates;
+        records[loc].flags = cell.flags;
+    }
+
+    std::ofstream of;
+    of.open(fileName, std::fstream::out | std::fstream::binary);
+    of.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    of.write(reinterpret_cast<const char *>(records.data()), records.size() * sizeof(CellRecord));
+    std::vector<char> padding(header.chaseOffset - sizeof(header) - records.size() * sizeof(CellRecord), 0);
+    of.write(padding.data(), padding.size());
+    of.write(reinterpret_cast<const char *>(this->chase), 4 * this->numCells * this->numCells * sizeof(std::uint16_t));
+    of.close();
+    return !of.fail();
+}
+
+/**
+ * @brief Parses a maze in the text format from the SIZE bytes at DATA
+ * into RECORDS and the initial state POS.
+ */
+template <class State>
+bool BasicMMz<State>::parseText(const char *data, std::size_t size, std::vector<CellRecord> &records, State &pos) {
+    const char *p = data;
+    const char *end = data + size;
+    if (!readNumber(p, end, this->rows) || !readNumber(p, end, this->cols) ||
+            this->rows == 0 || this->cols == 0 || this->rows * this->cols > MAX_CELLS) {
+        /* Error: locations do not fit in CHARACTER_LOC_LENGTH bits. */
+        return false;
+    }
+    std::size_t worldRows = toWorldDim(this->rows);
+    std::size_t worldCols = toWorldDim(this->cols);
+    std::string world(worldRows * worldCols, WALL);
+    p = std::find(p, end, '\n');
+    for (std::size_t i = 0; i < worldRows; ++i) {
+        /* Skip the line break before the row. */
+        if (p != end && *p == '\n') {
+            ++p;
+        }
+        if (std::size_t(end - p) < worldCols) {
+            return false;
+        }
+        for (std::size_t j = 0; j < worldCols; ++j, ++p) {
+            std::size_t loc = i * worldCols + j;
+            world[loc] = *p;
             if (isChr(world[loc])) {
-                addChr(this->initPos, world[loc], toGridLoc(loc, this->worldCols));
+                if (!addChr(pos, world[loc], toGridLoc(loc, worldCols))) {
+                    /* Error: second player or more than MAX_NPCS NPCs. */
+                    return false;
+                }
                 world[loc] = EMPTY;
             } else if (isGate(world[loc])) {
-                setGate(this->initPos, world[loc]);
+                setGate(pos, world[loc]);
                 world[loc] = GATE;
             }
         }
-        fin.get();
+        if (p != end && *p == '\r') {
+            ++p;
+        }
+    }
+
+    /* A step in some direction crosses the world unit between two
+     * cells, which may hold a wall or a gate. */
+    records.assign(this->rows * this->cols, CellRecord());
+    for (std::size_t loc = 0; loc < records.size(); ++loc) {
+        CellRecord &record = records[loc];
+        std::size_t worldLoc = toWorldLoc(loc, this->cols);
+        if (isTrap(world[worldLoc])) {
+            record.flags |= TRAP_CELL;
+        }
+        if (isKey(world[worldLoc])) {
+            record.flags |= KEY_CELL;
+        }
+        if (isExit(world[worldLoc])) {
+            record.flags |= EXIT_CELL;
+        }
+        for (int direction = 0; direction < MMzMove::NUM_POSSIBLE_MOVES; ++direction) {
+            int i_ofs, j_ofs;
+            getOffsets(direction, i_ofs, j_ofs);
+            char edge = world[worldLoc + i_ofs * worldCols + j_ofs];
+            if (edge == WALL) {
+                record.walls |= 1 << direction;
+            } else if (edge == GATE) {
+                record.gates |= 1 << direction;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Parses a maze in the binary format from the SIZE bytes at DATA
+ * into RECORDS and the initial state POS, and points CHASE to the chase
+ * table in DATA.
+ */
+template <class State>
+bool BasicMMz<State>::parseBinary(const char *data, std::size_t size, std::vector<CellRecord> &records, State &pos,
+                                  const std::uint16_t *&chase) {
+    MazeHeader header;
+    if (size < sizeof(header)) {
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+    std::uint64_t numCells = std::uint64_t(header.rows) * header.cols;
+    if (header.version != MAZE_VERSION || header.byteOrder != MAZE_BYTE_ORDER ||
+            header.maxNPCs != MAX_NPCS || numCells == 0 || numCells > MAX_CELLS ||
+            header.chaseOffset != chaseOffset(numCells) ||
+            header.chaseOffset > size || (size - header.chaseOffset) / 8 < numCells * numCells) {
+        return false;
+    }
+    chase = reinterpret_cast<const std::uint16_t *>(data + header.chaseOffset);
+    for (std::size_t i = 0; i < 4 * numCells * numCells; ++i) {
+        if ((chase[i] & ~CHASE_KEY) >= numCells) {
+            return false;
+        }
     }
-    fin.close();
+    this->rows = header.rows;
+    this->cols = header.cols;
+    records.resize(numCells);
+    std::memcpy(records.data(), data + sizeof(header), numCells * sizeof(CellRecord));
+    fromWords(header.initPos, pos);
+    return true;
+}
+
+/**
+ * @brief Builds the tables of the maze of ROWS x COLS cells described by
+ * RECORDS, with initial state POS. The chase table is built unless
+ * CHASE points to one in MAPPING.
+ */
+template <class State>
+bool BasicMMz<State>::load(State pos, const std::vector<CellRecord> &records,
+                           const std::shared_ptr<const MappedFile> &mapping, const std::uint16_t *chase) {
+    /* NPCs are added to the lowest free slots. */
+    this->numNPCs = 0;
+    while (this->numNPCs < MAX_NPCS && chrIsAlive(pos, this->numNPCs)) {
+        ++this->numNPCs;
+    }
+    for (std::size_t i = 0; i <= MAX_NPCS; ++i) {
+        if (chrIsAlive(pos, i) && (chrLoc(pos, i) >= records.size() || (i < MAX_NPCS && i >= this->numNPCs))) {
+            /* Error: character outside the grid or NPC slots not packed. */
+            return false;
+        }
+    }
+    this->twins = 0;
+    for (std::size_t i = 0; i < this->numNPCs; ++i) {
+        for (std::size_t j = i + 1; j < this->numNPCs; ++j) {
+            if (chrStrength(pos, i) == chrStrength(pos, j)) {
+                this->twins |= std::uint64_t(1) << (i * MAX_NPCS + j);
+            }
+        }
+    }
+    this->initPos = normalize(pos);
+    std::shared_ptr<Tables> tables(new Tables);
+    if (!buildCells(*tables, records)) {
+        return false;
+    }
+    this->numCells = tables->cells.size();
+    this->cells = tables->cells.data();
+    if (chase) {
+        tables->mapping = mapping;
+        this->chase = chase;
+    } else {
+        buildChase(*tables);
+        this->chase = tables->chase.data();
+    }
+    buildRanking(*tables);
+    this->numOpenCells = tables->openCells.size();
+    this->openCells = tables->openCells.data();
+    this->cellIndex = tables->cellIndex.data();
+    this->tables = tables;
     this->initialized = true;
     return true;
 }
 
-std::string MMz::asString(const MMzPosition *mmzPos) const {
-    std::stringstream ss;
-    std::size_t walker = 0;
-    for (std::size_t i = 0; i < this->worldRows; ++i) {
-        for (std::size_t j = 0; j < this->worldCols; ++j) {
-            bool replaced = false;
-            if (mmzPos && (i % 2) && (j % 2)) {
-                std::uint64_t pos = mmzPos->getPos();
-                for (std::uint64_t chrIdx = 0; chrIdx < PLAYER_IDX + 1; ++chrIdx) {
-                    if (chrIsAlive(pos, chrIdx) && chrLoc(pos, chrIdx) == toGridLoc(walker, this->worldCols)) {
-                        if (chrIdx == PLAYER_IDX) {
-                            ss.put(PLAYER);
-                        }
-                        else {
-                            ss.put('0' + chrStrength(pos, chrIdx));
-                        }
-                        replaced = true;
-                        break;
-                    }
-                }
+/**
+ * @brief Fills the cells of TABLES from RECORDS. Returns false if a step
+ * that no wall blocks leads off the grid.
+ */
+template <class State>
+bool BasicMMz<State>::buildCells(Tables &tables, const std::vector<CellRecord> &records) const {
+    tables.cells.assign(records.size(), Cell());
+    for (std::size_t loc = 0; loc < records.size(); ++loc) {
+        Cell &cell = tables.cells[loc];
+        std::size_t row = loc / this->cols;
+        std::size_t col = loc % this->cols;
+        cell.row = static_cast<std::uint16_t>(row);
+        cell.col = static_cast<std::uint16_t>(col);
+        cell.gates = 0;
+        cell.flags = records[loc].flags & (TRAP_CELL | KEY_CELL | EXIT_CELL);
+        for (int direction = 0; direction < MMzMove::NUM_POSSIBLE_MOVES; ++direction) {
+            int i_ofs, j_ofs;
+            getOffsets(direction, i_ofs, j_ofs);
+            if ((records[loc].walls >> direction) & 1) {
+                cell.dest[direction] = NO_CELL;
+                continue;
+            } else if (row + i_ofs >= this->rows || col + j_ofs >= this->cols) {
+                /* Unsigned wrap-around also catches steps off the top or
+                 * left edge. */
+                return false;
             }
-            if (!replaced) {
-                ss.put(world[walker]);
+            if ((records[loc].gates >> direction) & 1) {
+                cell.gates |= 1 << direction;
             }
-            walker++;
+            cell.dest[direction] = static_cast<std::uint16_t>(loc + i_ofs * this->cols + j_ofs);
+        }
+    }
+    return true;
+}
+
+template <class State>
+std::string BasicMMz<State>::asString(const PositionType *mmzPos) const {
+    std::stringstream ss;
+    std::size_t worldRows = toWorldDim(this->rows);
+    std::size_t worldCols = toWorldDim(this->cols);
+    for (std::size_t i = 0; i < worldRows; ++i) {
+        for (std::size_t j = 0; j < worldCols; ++j) {
+            ss.put(worldChar(mmzPos ? mmzPos->getPos() : State(0), i, j, mmzPos != nullptr));
         }
         ss.put('\n');
     }
@@ -243,160 +556,407 @@ std::string MMz::asString(const MMzPosition *mmzPos) const {
     return ss.str();
 }
 
-inline Position *MMz::getInitialPosition() const {
-    return new MMzPosition(this->initPos);
+/**
+ * @brief Returns the character at row I and column J of the text form of
+ * the maze, showing the characters of POS if SHOWCHRS is true.
+ */
+template <class State>
+char BasicMMz<State>::worldChar(State pos, std::size_t i, std::size_t j, bool showChrs) const {
+    std::size_t worldRows = toWorldDim(this->rows);
+    std::size_t worldCols = toWorldDim(this->cols);
+    if (i % 2 == 0 && j % 2 == 0) {
+        /* Corner between cells. */
+        bool border = i == 0 || j == 0 || i + 1 == worldRows || j + 1 == worldCols;
+        return border ? WALL : ' ';
+    } else if (i % 2 && j % 2) {
+        std::size_t loc = toGridLoc(i * worldCols + j, worldCols);
+        for (std::size_t chrIdx = 0; showChrs && chrIdx < MAX_NPCS + 1; ++chrIdx) {
+            if (chrIsAlive(pos, chrIdx) && chrLoc(pos, chrIdx) == loc) {
+                return chrIdx == MAX_NPCS ? PLAYER : char('0' + chrStrength(pos, chrIdx));
+            }
+        }
+        std::uint8_t flags = this->cells[loc].flags;
+        return (flags & TRAP_CELL) ? TRAP : (flags & KEY_CELL) ? KEY : (flags & EXIT_CELL) ? EXIT : EMPTY;
+    }
+    /* A world unit between two cells, seen from the cell below or to the
+     * right of it unless that cell is off the grid. */
+    int direction;
+    std::size_t row = i / 2;
+    std::size_t col = j / 2;
+    if (i % 2) {
+        direction = col < this->cols ? MMzMove::LEFT : MMzMove::RIGHT;
+        col = std::min(col, this->cols - 1);
+    } else {
+        direction = row < this->rows ? MMzMove::UP : MMzMove::DOWN;
+        row = std::min(row, this->rows - 1);
+    }
+    const Cell &cell = this->cells[row * this->cols + col];
+    if (cell.dest[direction] == NO_CELL) {
+        return WALL;
+    }
+    return ((cell.gates >> direction) & 1) ? GATE : ' ';
+}
+
+template <class State>
+State BasicMMz<State>::initialState() const {
+    return this->initPos;
 }
 
-bool MMz::isPrimitivePosition(const Position *pos_) const {
-    const MMzPosition *mmzPos = static_cast<const MMzPosition *>(pos_);
-    std::uint64_t pos = mmzPos->getPos();
-    std::uint64_t ploc = playerLoc(pos);
-    char unit = this->world[toWorldLoc(ploc, this->cols)];
-    return playerIsAlive(pos) && isExit(unit);
+template <class State>
+bool BasicMMz<State>::isPrimitiveState(State state) const {
+    return playerIsAlive(state) && (this->cells[playerLoc(state)].flags & EXIT_CELL);
 }
 
-std::vector<Move *> MMz::getMoves(const Position *pos_) const {
-    const MMzPosition *pos = static_cast<const MMzPosition *>(pos_);
-    std::vector<Move *> validMoves;
-    MMzMove *move;
+template <class State>
+std::size_t BasicMMz<State>::maxMoves() const {
+    return MMzMove::NUM_POSSIBLE_MOVES;
+}
+
+template <class State>
+std::size_t BasicMMz<State>::stateMoves(State state, MoveCode *moves) const {
+    std::size_t numMoves = 0;
     for (int i = 0; i < MMzMove::NUM_POSSIBLE_MOVES; ++i) {
-        move = new MMzMove(i);
-        if (isValidMove(pos, move)) {
-            validMoves.push_back(move);
-        } else {
-            delete move;
+        if (isValidMove(state, i)) {
+            moves[numMoves++] = static_cast<MoveCode>(i);
         }
     }
-    return validMoves;
+    return numMoves;
 }
 
-Position *MMz::doMove(const Position *pos_, const Move *move_) const {
-    const MMzPosition *mmzPos = static_cast<const MMzPosition *>(pos_);
-    const MMzMove *move = static_cast<const MMzMove *>(move_);
-    if (!isValidMove(mmzPos, move)) {
-        /* Not a valid move. */
-        return nullptr;
-    }
-    std::uint64_t pos = mmzPos->getPos();
+/**
+ * @brief Returns the position after making valid move MOVE at POS.
+ */
+template <class State>
+State BasicMMz<State>::applyMove(State pos, MoveCode move) const {
     std::uint64_t ploc = playerLoc(pos);
-    std::uint64_t newPloc = movePlayer(pos, move->getDirection(), this->cols);
+    std::uint16_t newPloc = this->cells[ploc].dest[move];
+    chrSetLoc(pos, newPloc, MAX_NPCS);
+    std::uint8_t flags = this->cells[newPloc].flags;
     /* If player steps on a trap, kill player. */
-    if (isTrap(this->world[toWorldLoc(newPloc, this->cols)])) {
-        killPlayer(pos);
-        return new MMzPosition(pos);
-    } else if (newPloc != ploc && isKey(this->world[toWorldLoc(newPloc, this->cols)])) {
+    if (flags & TRAP_CELL) {
+        return DEAD_STATE;
+    } else if (newPloc != ploc && (flags & KEY_CELL)) {
         toggleGate(pos);
     }
     /* Handle NPCs. */
     bool gateToggled;
     for (int i = 0; i < 3; ++i) {
         if (moveNPCs(pos, i != 0, gateToggled)) {
-            return new MMzPosition(pos);
+            return DEAD_STATE;
         } else if (gateToggled) {
             toggleGate(pos);
         }
     }
-    return new MMzPosition(pos);
+    return normalize(pos);
+}
+
+/**
+ * @brief Returns the representative of the states that play the same
+ * as STATE. Killed NPCs leave the maze, so their bits are cleared.
+ * NPCs of equal strength are interchangeable, so they are sorted by
+ * slot. All states in which the player is dead are merged into
+ * DEAD_STATE.
+ */
+template <class State>
+State BasicMMz<State>::normalize(State state) const {
+    if (!playerIsAlive(state)) {
+        return DEAD_STATE;
+    }
+    /* Spread the alive bit of every dead NPC over its whole info. */
+    State dead = ~state & npcLanes<State>(CHARACTER_ALIVE_SHIFT);
+    state &= ~((dead >> CHARACTER_ALIVE_SHIFT) * State(CHARACTER_INFO_MASK));
+    /* Pairs in the order i < j, then j ascending, which sorts each set
+     * of twins. */
+    for (std::uint64_t pairs = this->twins; pairs; pairs &= pairs - 1) {
+        std::size_t i = lowestBit(pairs) / MAX_NPCS;
+        std::size_t j = lowestBit(pairs) % MAX_NPCS;
+        std::uint64_t infoI = chrInfo(state, i);
+        std::uint64_t infoJ = chrInfo(state, j);
+        if (infoJ < infoI) {
+            chrSetInfo(state, infoJ, i);
+            chrSetInfo(state, infoI, j);
+        }
+    }
+    return state;
+}
+
+template <class State>
+std::string BasicMMz<State>::moveString(MoveCode move) const {
+    return MMzMove(static_cast<int>(move)).toString();
+}
+
+template <class State>
+Position *BasicMMz<State>::getInitialPosition() const {
+    return new PositionType(initialState(), hashOf(initialState()));
+}
+
+template <class State>
+bool BasicMMz<State>::isPrimitivePosition(const Position *pos_) const {
+    const PositionType *mmzPos = static_cast<const PositionType *>(pos_);
+    return isPrimitiveState(mmzPos->getPos());
+}
+
+template <class State>
+std::vector<Move *> BasicMMz<State>::getMoves(const Position *pos_) const {
+    const PositionType *pos = static_cast<const PositionType *>(pos_);
+    std::vector<Move *> validMoves;
+    for (int i = 0; i < MMzMove::NUM_POSSIBLE_MOVES; ++i) {
+        if (isValidMove(pos->getPos(), i)) {
+            validMoves.push_back(new MMzMove(i));
+        }
+    }
+    return validMoves;
 }
 
-Puzzle *MMz::getCopy() const {
-    return new MMz(*this);
+template <class State>
+Position *BasicMMz<State>::doMove(const Position *pos_, const Move *move_) const {
+    const PositionType *mmzPos = static_cast<const PositionType *>(pos_);
+    const MMzMove *move = static_cast<const MMzMove *>(move_);
+    if (!isValidMove(mmzPos->getPos(), move->getDirection())) {
+        /* Not a valid move. */
+        return nullptr;
+    }
+    State child = applyMove(mmzPos->getPos(), move->getDirection());
+    return new PositionType(child, hashOf(child));
 }
 
-std::uint64_t MMz::getDestLoc(std::uint64_t pos, std::size_t chrIdx, int direction) const {
-    int i_ofs, j_ofs;
-    getOffsets(direction, i_ofs, j_ofs);
-    std::uint64_t loc = chrLoc(pos, chrIdx);
-    std::uint64_t worldLoc = toWorldLoc(loc, this->cols);
-    std::uint64_t wallWorldLoc = worldLoc + i_ofs * this->worldCols + j_ofs;
+template <class State>
+std::size_t BasicMMz<State>::getMoveCodes(const Position *pos, MoveCode *moves) const {
+    return stateMoves(static_cast<const PositionType *>(pos)->getPos(), moves);
+}
+
+template <class State>
+void BasicMMz<State>::doMove(const Position *pos, MoveCode move, Position *child) const {
+    State state = applyMove(static_cast<const PositionType *>(pos)->getPos(), move);
+    static_cast<PositionType *>(child)->setPos(state, hashOf(state));
+}
+
+template <class State>
+Puzzle *BasicMMz<State>::getCopy() const {
+    return new BasicMMz(*this);
+}
+
+/**
+ * @brief Returns the cell reached by moving in DIRECTION from cell LOC,
+ * or INVALID_LOC if it is blocked.
+ */
+template <class State>
+inline std::uint64_t BasicMMz<State>::getDestLoc(std::uint64_t loc, bool gateClosed, int direction) const {
+    const Cell &cell = this->cells[loc];
     /* Destination is not reachable if wall or closed gate is blocking the way. */
-    if (this->world[wallWorldLoc] == WALL) {
+    if (cell.dest[direction] == NO_CELL) {
         return INVALID_LOC;
-    } else if (this->world[wallWorldLoc] == GATE && gateIsClosed(pos)) {
+    } else if (((cell.gates >> direction) & 1) && gateClosed) {
         return INVALID_LOC;
     }
-    return wallWorldLoc + i_ofs * this->worldCols + j_ofs;
+    return cell.dest[direction];
 }
 
 /**
- * @brief Returns true if MOVE is valid at POS.
+ * @brief Returns true if moving in DIRECTION is valid at POS.
  * A player move is valid if and only if there is
- * no wall blocking the path and there is no NPC
- * at destination.
+ * no wall or closed gate blocking the path.
  */
-bool MMz::isValidMove(const MMzPosition *mmzPos, const MMzMove *move) const {
-    std::uint64_t pos = mmzPos->getPos();
-    int dir = move->getDirection();
+template <class State>
+bool BasicMMz<State>::isValidMove(State pos, int direction) const {
     if (!playerIsAlive(pos)) {
         /* No moves are available if player is dead. */
         return false;
     }
-    std::uint64_t destWorldLoc = getDestLoc(pos, PLAYER_IDX, dir);
-    if (destWorldLoc == INVALID_LOC) {
-        return false;
+    return getDestLoc(playerLoc(pos), gateIsClosed(pos), direction) != INVALID_LOC;
+}
+
+/**
+ * @brief Fills CHASE with the step of every NPC color from every cell
+ * towards every player cell, with the gate open and closed.
+ */
+template <class State>
+void BasicMMz<State>::buildChase(Tables &tables) const {
+    std::size_t n = this->numCells;
+    tables.chase.assign(4 * n * n, 0);
+    for (int gateClosed = 0; gateClosed < 2; ++gateClosed) {
+        for (int red = 0; red < 2; ++red) {
+            for (std::uint64_t nloc = 0; nloc < n; ++nloc) {
+                for (std::uint64_t ploc = 0; ploc < n; ++ploc) {
+                    std::uint64_t dest = chaseStep(nloc, ploc, red, gateClosed);
+                    std::uint16_t entry = static_cast<std::uint16_t>(dest);
+                    if (dest != nloc && (this->cells[dest].flags & KEY_CELL)) {
+                        entry |= CHASE_KEY;
+                    }
+                    tables.chase[chaseIndex(gateClosed, red, nloc, ploc)] = entry;
+                }
+            }
+        }
     }
-    return !isNPC(this->world[destWorldLoc]);
 }
 
-std::uint64_t MMz::moveNPC(std::uint64_t &pos, std::uint64_t chrIdx, bool &gateToggled) const {
-    std::uint64_t ploc = playerLoc(pos);
-    std::uint64_t nloc = chrLoc(pos, chrIdx);
-    std::uint64_t newNloc = nloc;
-    std::uint64_t p_i = ploc / this->cols;
-    std::uint64_t p_j = ploc % this->cols;
-    std::uint64_t n_i = nloc / this->cols;
-    std::uint64_t n_j = nloc % this->cols;
-    std::uint64_t destWorldLoc;
+/**
+ * @brief Fills OPENCELLS and CELLINDEX with the cells reachable from the
+ * initial cells of all characters, taking every gate as open, and sets
+ * the number of ranks.
+ */
+template <class State>
+void BasicMMz<State>::buildRanking(Tables &tables) {
+    tables.cellIndex.assign(this->numCells, std::uint16_t(NO_CELL));
+    tables.openCells.clear();
+    auto open = [&tables](std::uint64_t loc) {
+        if (tables.cellIndex[loc] == NO_CELL) {
+            tables.cellIndex[loc] = static_cast<std::uint16_t>(tables.openCells.size());
+            tables.openCells.push_back(static_cast<std::uint16_t>(loc));
+        }
+    };
+    open(playerLoc(this->initPos));
+    for (std::size_t i = 0; i < this->numNPCs; ++i) {
+        open(chrLoc(this->initPos, i));
+    }
+    bool hasKeys = false;
+    for (std::size_t next = 0; next < tables.openCells.size(); ++next) {
+        const Cell &cell = this->cells[tables.openCells[next]];
+        hasKeys |= bool(cell.flags & KEY_CELL);
+        for (int direction = 0; direction < MMzMove::NUM_POSSIBLE_MOVES; ++direction) {
+            if (cell.dest[direction] != NO_CELL) {
+                open(cell.dest[direction]);
+            }
+        }
+    }
+    this->gateStates = hasKeys ? 2 : 1;
+    std::uint64_t numOpen = tables.openCells.size();
+    bool fits = !__builtin_mul_overflow(this->gateStates, numOpen, &this->numRanks);
+    for (std::size_t i = 0; i < this->numNPCs; ++i) {
+        fits = fits && !__builtin_mul_overflow(this->numRanks, numOpen + 1, &this->numRanks);
+    }
+    /* DEAD_STATE */
+    fits = fits && !__builtin_add_overflow(this->numRanks, 1, &this->numRanks);
+    if (!fits) {
+        this->numRanks = 0;
+    }
+}
+
+template <class State>
+inline std::size_t BasicMMz<State>::chaseIndex(bool gateClosed, bool red, std::uint64_t nloc, std::uint64_t ploc) const {
+    std::size_t n = this->numCells;
+    return ((std::size_t(gateClosed) * 2 + red) * n + nloc) * n + ploc;
+}
+
+/**
+ * @brief Returns the cell that an NPC at NLOC steps to when chasing the
+ * player at PLOC, which is NLOC itself if it cannot get closer.
+ */
+template <class State>
+std::uint64_t BasicMMz<State>::chaseStep(std::uint64_t nloc, std::uint64_t ploc, bool red, bool gateClosed) const {
+    const Cell &player = this->cells[ploc];
+    const Cell &npc = this->cells[nloc];
+    std::uint64_t destLoc;
     /* At most one of the following 8 branches will get executed.
      * No branch is entered if and only if no move is valid. */
-    if (chrIsRed(pos, chrIdx)) {
-        /* Prioritizes vertical moves. */
-        if (n_i > p_i && (destWorldLoc = getDestLoc(pos, chrIdx, MMzMove::UP)) != INVALID_LOC) {
-            newNloc = toGridLoc(destWorldLoc, this->worldCols);
-        } else if (n_i < p_i && (destWorldLoc = getDestLoc(pos, chrIdx, MMzMove::DOWN)) != INVALID_LOC) {
-            newNloc = toGridLoc(destWorldLoc, this->worldCols);
-        } else if (n_j > p_j && (destWorldLoc = getDestLoc(pos, chrIdx, MMzMove::LEFT)) != INVALID_LOC) {
-            newNloc = toGridLoc(destWorldLoc, this->worldCols);
-        } else if (n_j < p_j && (destWorldLoc = getDestLoc(pos, chrIdx, MMzMove::RIGHT)) != INVALID_LOC) {
-            newNloc = toGridLoc(destWorldLoc, this->worldCols);
+    if (red) {
+        /* Red NPCs prioritize vertical moves. */
+        if (npc.row > player.row && (destLoc = getDestLoc(nloc, gateClosed, MMzMove::UP)) != INVALID_LOC) {
+            return destLoc;
+        } else if (npc.row < player.row && (destLoc = getDestLoc(nloc, gateClosed, MMzMove::DOWN)) != INVALID_LOC) {
+            return destLoc;
+        } else if (npc.col > player.col && (destLoc = getDestLoc(nloc, gateClosed, MMzMove::LEFT)) != INVALID_LOC) {
+            return destLoc;
+        } else if (npc.col < player.col && (destLoc = getDestLoc(nloc, gateClosed, MMzMove::RIGHT)) != INVALID_LOC) {
+            return destLoc;
         }
     } else {
-        /* Prioritizes horizontal moves. */
-        if (n_j > p_j && (destWorldLoc = getDestLoc(pos, chrIdx, MMzMove::LEFT)) != INVALID_LOC) {
-            newNloc = toGridLoc(destWorldLoc, this->worldCols);
-        } else if (n_j < p_j && (destWorldLoc = getDestLoc(pos, chrIdx, MMzMove::RIGHT)) != INVALID_LOC) {
-            newNloc = toGridLoc(destWorldLoc, this->worldCols);
-        } else if (n_i > p_i && (destWorldLoc = getDestLoc(pos, chrIdx, MMzMove::UP)) != INVALID_LOC) {
-            newNloc = toGridLoc(destWorldLoc, this->worldCols);
-        } else if (n_i < p_i && (destWorldLoc = getDestLoc(pos, chrIdx, MMzMove::DOWN)) != INVALID_LOC) {
-            newNloc = toGridLoc(destWorldLoc, this->worldCols);
+        /* White NPCs prioritize horizontal moves. */
+        if (npc.col > player.col && (destLoc = getDestLoc(nloc, gateClosed, MMzMove::LEFT)) != INVALID_LOC) {
+            return destLoc;
+        } else if (npc.col < player.col && (destLoc = getDestLoc(nloc, gateClosed, MMzMove::RIGHT)) != INVALID_LOC) {
+            return destLoc;
+        } else if (npc.row > player.row && (destLoc = getDestLoc(nloc, gateClosed, MMzMove::UP)) != INVALID_LOC) {
+            return destLoc;
+        } else if (npc.row < player.row && (destLoc = getDestLoc(nloc, gateClosed, MMzMove::DOWN)) != INVALID_LOC) {
+            return destLoc;
         }
     }
-    chrSetLoc(pos, newNloc, chrIdx);
-    if (newNloc != nloc && isKey(this->world[toWorldLoc(newNloc, this->cols)])) {
-        gateToggled = true;
-    }
-    return 0;
+    return nloc;
 }
 
 /**
  * @brief Move NPCs and return true if player is killed afterwards.
+ * Mummies walk and move in the last two rounds, scorpions in the first.
+ *
+ * NPCs are moved in place in POS. The NPCs of the round are picked for
+ * all slots at once from their alive and walking bits, so only they are
+ * visited, each with a single chase table lookup.
+ */
+template <class State>
+bool BasicMMz<State>::moveNPCs(State &pos, bool walking, bool &gateToggled) const {
+    const std::uint16_t *table = &this->chase[chaseIndex(gateIsClosed(pos), false, 0, playerLoc(pos))];
+    std::size_t n = this->numCells;
+    State aliveBits = npcLanes<State>(CHARACTER_ALIVE_SHIFT);
+    State walkers = (pos >> (CHARACTER_WALKING_SHIFT - CHARACTER_ALIVE_SHIFT)) & aliveBits;
+    State movers = pos & aliveBits & (walking ? walkers : ~walkers);
+    State moved = movers;
+    /* The steps are gathered apart from POS, so that the lookups do not
+     * wait for each other. */
+    State steps = 0;
+    unsigned toggled = 0;
+    for (; movers; movers &= movers - 1) {
+        std::size_t shift = lowestBit(movers) - CHARACTER_ALIVE_SHIFT;
+        std::uint64_t info = static_cast<std::uint64_t>(pos >> shift);
+        bool red = (info >> CHARACTER_COLOR_SHIFT) & 1;
+        std::uint16_t entry = table[(red * n + (info & CHARACTER_LOC_MASK)) * n];
+        steps |= State((info ^ entry) & CHARACTER_LOC_MASK) << shift;
+        toggled |= entry;
+    }
+    pos ^= steps;
+    gateToggled = toggled & CHASE_KEY;
+    return collect(pos, moved);
+}
+
+/**
+ * @brief Let NPCs kill each other and kill player if possible.
+ * Returns true if player is killed, false otherwise. Dead NPCs are
+ * gone from the maze and take no part in fights.
+ *
+ * Only the cells of the NPCs in MOVED, given as alive bits, can hold
+ * more than one NPC. The NPCs sharing such a cell are found for all
+ * slots at once by comparing every NPC location with that cell, so each
+ * cell is visited once. Of the NPCs in a cell, the first of the
+ * strongest survives.
  */
-bool MMz::moveNPCs(std::uint64_t &pos, bool walking, bool &gateToggled) const {
-    gateToggled = false;
-    for (std::uint64_t i = 0; i < MAX_NPCS; ++i) {
-        if (chrIsAlive(pos, i) && chrIsWalking(pos, i) == walking) {
-            moveNPC(pos, i, gateToggled);
+template <class State>
+bool BasicMMz<State>::collect(State &pos, State moved) const {
+    State aliveBits = npcLanes<State>(CHARACTER_ALIVE_SHIFT);
+    State alive = pos & aliveBits;
+    if (npcsAt(pos, playerLoc(pos)) & alive) {
+        return true;
+    } else if (!(alive & (alive - 1))) {
+        return false;
+    }
+    /* Strength bits of every NPC, moved to its alive bit. */
+    State colors = (pos >> (CHARACTER_COLOR_SHIFT - CHARACTER_ALIVE_SHIFT)) & aliveBits;
+    State walkers = (pos >> (CHARACTER_WALKING_SHIFT - CHARACTER_ALIVE_SHIFT)) & aliveBits;
+    for (State pending = moved; pending;) {
+        std::size_t first = lowestBit(pending) / CHARACTER_INFO_LENGTH;
+        State group = npcsAt(pos, chrLoc(pos, first)) & alive;
+        pending &= ~group;
+        if (!(group & (group - 1))) {
+            continue;
+        }
+        State strongest = group;
+        if (strongest & walkers) {
+            strongest &= walkers;
         }
+        if (strongest & colors) {
+            strongest &= colors;
+        }
+        /* Kill all but the first of the strongest. */
+        pos &= ~(group ^ (strongest & (~strongest + 1)));
     }
-    return collect(pos);
+    return false;
 }
 
 namespace {
 /* Helper functions */
-inline void setBit(std::uint64_t &number, std::size_t n, bool x) {
+template <class State>
+inline void setBit(State &number, std::size_t n, bool x) {
     /* Clear the Nth bit, then set it to X. */
-    number = (number & ~(ONE << n)) | (static_cast<std::uint64_t>(x) << n);
+    number = (number & ~(State(1) << n)) | (State(x) << n);
 }
 
 inline std::size_t toWorldDim(std::size_t gridDim) {
@@ -445,23 +1005,79 @@ inline bool isTrap(char c) {
     return c == TRAP;
 }
 
-inline void chrSetAlive(std::uint64_t &pos, std::uint64_t chrIdx) {
-    pos |= CHARACTER_ALIVE_MASK << (chrIdx * CHARACTER_INFO_LENGTH);
+/**
+ * @brief Reads the decimal number after any blanks at P into N and moves
+ * P past it. Returns false if there is no number.
+ */
+bool readNumber(const char *&p, const char *end, std::size_t &n) {
+    while (p != end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) {
+        ++p;
+    }
+    if (p == end || *p < '0' || *p > '9') {
+        return false;
+    }
+    n = 0;
+    for (; p != end && *p >= '0' && *p <= '9'; ++p) {
+        /* Saturate well above MAX_CELLS rather than overflow. */
+        n = std::min<std::size_t>(n * 10 + (*p - '0'), std::size_t(1) << 20);
+    }
+    return true;
+}
+
+inline void toWords(std::uint64_t state, std::uint64_t *words) {
+    words[0] = state;
+    words[1] = 0;
 }
 
-inline void chrSetLoc(std::uint64_t &pos, std::uint64_t loc, std::uint64_t chrIdx) {
-    std::uint64_t shift = chrIdx * CHARACTER_INFO_LENGTH;
-    pos &= ~(CHARACTER_LOC_MASK << shift);
-    pos |= loc << shift;
+inline void toWords(Uint128 state, std::uint64_t *words) {
+    words[0] = static_cast<std::uint64_t>(state);
+    words[1] = static_cast<std::uint64_t>(state >> 64);
 }
 
-inline void chrSetStrength(std::uint64_t &pos, std::uint64_t strength, std::uint64_t chrIdx) {
-    std::uint64_t shift = chrIdx * CHARACTER_INFO_LENGTH;
-    pos &= ~(CHARACTER_STRENGTH_MASK << shift);
-    pos |= strength << (shift + CHARACTER_STRENGTH_SHIFT);
+inline void fromWords(const std::uint64_t *words, std::uint64_t &state) {
+    state = words[0];
 }
 
-bool addChr(std::uint64_t& pos, char chr, std::uint64_t loc) {
+inline void fromWords(const std::uint64_t *words, Uint128 &state) {
+    state = (Uint128(words[1]) << 64) | words[0];
+}
+
+inline std::uint64_t stateHash(std::uint64_t state) {
+    return mixHash(state);
+}
+
+inline std::uint64_t stateHash(Uint128 state) {
+    return mixHash(state);
+}
+
+template <class State>
+inline void chrSetAlive(State &pos, std::size_t chrIdx) {
+    setBit(pos, chrIdx * CHARACTER_INFO_LENGTH + CHARACTER_ALIVE_SHIFT, true);
+}
+
+template <class State>
+inline void chrSetLoc(State &pos, std::uint64_t loc, std::size_t chrIdx) {
+    std::size_t shift = chrIdx * CHARACTER_INFO_LENGTH;
+    pos &= ~(State(CHARACTER_LOC_MASK) << shift);
+    pos |= State(loc) << shift;
+}
+
+template <class State>
+inline void chrSetStrength(State &pos, std::uint64_t strength, std::size_t chrIdx) {
+    std::size_t shift = chrIdx * CHARACTER_INFO_LENGTH + CHARACTER_STRENGTH_SHIFT;
+    pos &= ~(State(CHARACTER_STRENGTH_MASK) << shift);
+    pos |= State(strength) << shift;
+}
+
+template <class State>
+inline void chrSetInfo(State &pos, std::uint64_t info, std::size_t chrIdx) {
+    std::size_t shift = chrIdx * CHARACTER_INFO_LENGTH;
+    pos &= ~(State(CHARACTER_INFO_MASK) << shift);
+    pos |= State(info) << shift;
+}
+
+template <class State>
+bool addChr(State& pos, char chr, std::uint64_t loc) {
     std::uint64_t strength = chr - '0';
     if (strength == PLAYER_STRENGTH) {
         /* Player */
@@ -469,12 +1085,12 @@ bool addChr(std::uint64_t& pos, char chr, std::uint64_t loc) {
             /* Error: player already exists. */
             return false;
         }
-        chrSetAlive(pos, PLAYER_IDX);
-        chrSetLoc(pos, loc, PLAYER_IDX);
+        chrSetAlive(pos, Layout<State>::PLAYER_IDX);
+        chrSetLoc(pos, loc, Layout<State>::PLAYER_IDX);
         return true;
     } else {
         /* NPC */
-        for (std::size_t i = 0; i < MAX_NPCS; ++i) {
+        for (std::size_t i = 0; i < MMzStateTraits<State>::MAX_NPCS; ++i) {
             if (!chrIsAlive(pos, i)) {
                 chrSetAlive(pos, i);
                 chrSetLoc(pos, loc, i);
@@ -487,49 +1103,13 @@ bool addChr(std::uint64_t& pos, char chr, std::uint64_t loc) {
     }
 }
 
-inline void killChr(std::uint64_t &pos, std::size_t chrIdx) {
-    pos &= ~(CHARACTER_ALIVE_MASK << (chrIdx * CHARACTER_INFO_LENGTH));
-}
-
-inline void killPlayer(std::uint64_t &pos) {
-    killChr(pos, PLAYER_IDX);
+template <class State>
+inline void killChr(State &pos, std::size_t chrIdx) {
+    setBit(pos, chrIdx * CHARACTER_INFO_LENGTH + CHARACTER_ALIVE_SHIFT, false);
 }
 
-/**
- * @brief Let NPCs kill each other and kill player if possible.
- * Returns true if player is killed, false otherwise.
- */
-bool collect(std::uint64_t &pos) {
-    std::uint64_t nloc1, nloc2;
-    std::uint64_t ploc = playerLoc(pos);
-    for (std::uint64_t i = 0; i < MAX_NPCS; ++i) {
-        if (!chrIsAlive(pos, i)) {
-            continue;
-        }
-        /* Kill player if possible. */
-        nloc1 = chrLoc(pos, i);
-        if (nloc1 == ploc) {
-            killPlayer(pos);
-        }
-        for (std::uint64_t j = i + 1; j < MAX_NPCS; ++j) {
-            nloc2 = chrLoc(pos, j);
-            if (nloc1 == nloc2) {
-                if (chrStrength(pos, i) < chrStrength(pos, j)) {
-                    /* Kill i. */
-                    killChr(pos, i);
-                    /* NPC i already dead. */
-                    break;
-                } else {
-                    /* Kill j. */
-                    killChr(pos, j);
-                }
-            }
-        }
-    }
-    return !playerIsAlive(pos);
-}
-
-void setGate(std::uint64_t& pos, char gate) {
+template <class State>
+void setGate(State& pos, char gate) {
     if (gate == GATE) {
         setGate(pos, true);
     } else if (gate == UNLOCKED_GATE) {
@@ -540,56 +1120,86 @@ void setGate(std::uint64_t& pos, char gate) {
     }
 }
 
-void setGate(std::uint64_t& pos, bool closed) {
-    setBit(pos, GATE_SHIFT, closed);
+template <class State>
+void setGate(State& pos, bool closed) {
+    setBit(pos, Layout<State>::GATE_SHIFT, closed);
 }
 
-void toggleGate(std::uint64_t &pos) {
-    pos ^= ONE << GATE_SHIFT;
+template <class State>
+void toggleGate(State &pos) {
+    pos ^= State(1) << Layout<State>::GATE_SHIFT;
+}
+
+/**
+ * @brief Returns a STATE with bit SHIFT of every NPC info set.
+ */
+template <class State>
+inline State npcLanes(std::size_t shift) {
+    State lanes = 0;
+    for (std::size_t i = 0; i < MMzStateTraits<State>::MAX_NPCS; ++i) {
+        lanes |= State(1) << (i * CHARACTER_INFO_LENGTH + shift);
+    }
+    return lanes;
 }
 
-std::uint64_t moveChr(std::uint64_t &pos, std::size_t chrIdx, int direction, std::size_t gridCols) {
-    int i_ofs, j_ofs;
-    getOffsets(direction, i_ofs, j_ofs);
-    std::uint64_t destLoc = chrLoc(pos, chrIdx) + i_ofs * gridCols + j_ofs;
-    chrSetLoc(pos, destLoc, chrIdx);
-    return destLoc;
+/**
+ * @brief Returns the alive bits of the NPC slots of POS whose location
+ * is LOC, whether or not the NPCs are alive.
+ */
+template <class State>
+inline State npcsAt(State pos, std::uint64_t loc) {
+    State ones = npcLanes<State>(0);
+    State locMasks = ones * State(CHARACTER_LOC_MASK);
+    /* Locations differing from LOC leave a nonzero field, which carries
+     * into the alive bit when the field mask is added. Fields never carry
+     * into the next info. */
+    State diff = (pos ^ (ones * State(loc))) & locMasks;
+    return ~(diff + locMasks) & (ones << CHARACTER_ALIVE_SHIFT);
 }
 
-std::uint64_t movePlayer(std::uint64_t &pos, int direction, std::size_t gridCols) {
-    return moveChr(pos, PLAYER_IDX, direction, gridCols);
+inline std::size_t lowestBit(std::uint64_t bits) {
+    return __builtin_ctzll(bits);
 }
 
-inline bool gateIsClosed(std::uint64_t pos) {
-    return pos & GATE_MASK;
+inline std::size_t lowestBit(Uint128 bits) {
+    std::uint64_t low = static_cast<std::uint64_t>(bits);
+    return low ? __builtin_ctzll(low) : 64 + __builtin_ctzll(static_cast<std::uint64_t>(bits >> 64));
 }
 
-inline std::uint64_t chrLoc(std::uint64_t pos, std::size_t chrIdx) {
-    return (pos >> (chrIdx * CHARACTER_INFO_LENGTH)) & CHARACTER_LOC_MASK;
+template <class State>
+inline bool gateIsClosed(State pos) {
+    return (pos >> Layout<State>::GATE_SHIFT) & 1;
 }
 
-inline bool chrIsAlive(std::uint64_t pos, std::size_t chrIdx) {
-    return pos & (CHARACTER_ALIVE_MASK << (chrIdx * CHARACTER_INFO_LENGTH));
+template <class State>
+inline std::uint64_t chrLoc(State pos, std::size_t chrIdx) {
+    return static_cast<std::uint64_t>(pos >> (chrIdx * CHARACTER_INFO_LENGTH)) & CHARACTER_LOC_MASK;
 }
 
-inline bool chrIsWalking(std::uint64_t pos, std::size_t chrIdx) {
-    return pos & (CHARACTER_WALKING_MASK << (chrIdx * CHARACTER_INFO_LENGTH));
+template <class State>
+inline bool chrIsAlive(State pos, std::size_t chrIdx) {
+    return (pos >> (chrIdx * CHARACTER_INFO_LENGTH + CHARACTER_ALIVE_SHIFT)) & 1;
 }
 
-inline bool chrIsRed(std::uint64_t pos, std::size_t chrIdx) {
-    return pos & (CHARACTER_COLOR_MASK << (chrIdx * CHARACTER_INFO_LENGTH));
+template <class State>
+inline std::uint64_t chrStrength(State pos, std::size_t chrIdx) {
+    return static_cast<std::uint64_t>(pos >> (chrIdx * CHARACTER_INFO_LENGTH + CHARACTER_STRENGTH_SHIFT)) &
+           CHARACTER_STRENGTH_MASK;
 }
 
-inline std::uint64_t chrStrength(std::uint64_t pos, std::size_t chrIdx) {
-    return ((pos >> (chrIdx * CHARACTER_INFO_LENGTH)) & CHARACTER_STRENGTH_MASK) >> CHARACTER_STRENGTH_SHIFT;
+template <class State>
+inline std::uint64_t chrInfo(State pos, std::size_t chrIdx) {
+    return static_cast<std::uint64_t>(pos >> (chrIdx * CHARACTER_INFO_LENGTH)) & CHARACTER_INFO_MASK;
 }
 
-inline std::uint64_t playerLoc(std::uint64_t pos) {
-    return chrLoc(pos, PLAYER_IDX);
+template <class State>
+inline std::uint64_t playerLoc(State pos) {
+    return chrLoc(pos, Layout<State>::PLAYER_IDX);
 }
 
-inline bool playerIsAlive(std::uint64_t pos) {
-    return chrIsAlive(pos, PLAYER_IDX);
+template <class State>
+inline bool playerIsAlive(State pos) {
+    return chrIsAlive(pos, Layout<State>::PLAYER_IDX);
 }
 
 void getOffsets(int direction, int &i_ofs, int &j_ofs) {
@@ -619,6 +1229,97 @@ void getOffsets(int direction, int &i_ofs, int &j_ofs) {
 } // Anonymous namespace
 
 
-std::size_t MMz::hashSize() const {
-    return 0;
+template <class State>
+std::size_t BasicMMz<State>::hashSize() const {
+    return this->numRanks;
+}
+
+template <class State>
+bool BasicMMz<State>::hasInjectiveHash() const {
+    return this->numRanks != 0;
+}
+
+template <class State>
+bool BasicMMz<State>::unhash(std::size_t hash, Position *pos) const {
+    if (hash >= this->numRanks) {
+        return false;
+    }
+    static_cast<PositionType *>(pos)->setPos(unrank(hash), hash);
+    return true;
+}
+
+/**
+ * @brief Returns the rank of STATE, a dense index below hashSize().
+ * STATE must be a state returned by applyMove() or initialState(), and
+ * ranks must fit in 64 bits.
+ *
+ * DEAD_STATE has rank 0. Any other rank is one plus a number whose
+ * digits, from the lowest up, hold the gate state if the maze has keys,
+ * the player's open cell index, and for each NPC either 0 if it is dead
+ * or one plus its open cell index. NPC strengths never change and are
+ * not part of the rank.
+ */
+template <class State>
+std::uint64_t BasicMMz<State>::rankOf(State state) const {
+    if (state == DEAD_STATE) {
+        return 0;
+    }
+    std::uint64_t numOpen = this->numOpenCells;
+    std::uint64_t rank = 1 + (this->gateStates == 2 && gateIsClosed(state));
+    std::uint64_t weight = this->gateStates;
+    rank += this->cellIndex[playerLoc(state)] * weight;
+    weight *= numOpen;
+    for (std::size_t i = 0; i < this->numNPCs; ++i) {
+        if (chrIsAlive(state, i)) {
+            rank += (this->cellIndex[chrLoc(state, i)] + 1) * weight;
+        }
+        weight *= numOpen + 1;
+    }
+    return rank;
+}
+
+/**
+ * @brief Returns the state whose rank is RANK.
+ */
+template <class State>
+State BasicMMz<State>::unrank(std::uint64_t rank) const {
+    if (rank == 0) {
+        return DEAD_STATE;
+    }
+    --rank;
+    std::uint64_t numOpen = this->numOpenCells;
+    State state = 0;
+    if (this->gateStates == 2) {
+        setGate(state, bool(rank & 1));
+    } else {
+        setGate(state, gateIsClosed(this->initPos));
+    }
+    rank /= this->gateStates;
+    chrSetAlive(state, MAX_NPCS);
+    chrSetLoc(state, this->openCells[rank % numOpen], MAX_NPCS);
+    rank /= numOpen;
+    for (std::size_t i = 0; i < this->numNPCs; ++i) {
+        std::uint64_t npc = rank % (numOpen + 1);
+        rank /= numOpen + 1;
+        if (npc != 0) {
+            chrSetStrength(state, chrStrength(this->initPos, i), i);
+            chrSetAlive(state, i);
+            chrSetLoc(state, this->openCells[npc - 1], i);
+        }
+    }
+    return state;
+}
+
+/**
+ * @brief Returns the hash of STATE, which is its rank if ranks fit in 64
+ * bits.
+ */
+template <class State>
+std::uint64_t BasicMMz<State>::hashOf(State state) const {
+    return this->numRanks ? rankOf(state) : stateHash(state);
 }
+
+template class BasicMMzPosition<std::uint64_t>;
+template class BasicMMz<std::uint64_t>;
+template class BasicMMzPosition<Uint128>;
+template class BasicMMz<Uint128>;
@@ -1,19 +1,44 @@
 #ifndef MMZ_H
 #define MMZ_H
+#include "mappedfile.h"
 #include "puzzle.h"
+#include <memory>
+#include <vector>
+
+/* 128-bit unsigned integer, the packed state of a WideMMz. */
+typedef unsigned __int128 Uint128;
+
+/**
+ * @brief Number of NPCs that fit in a packed state of type STATE. Every
+ * NPC takes 13 bits, the player 11 bits and the gate 1 bit.
+ */
+template <class State> struct MMzStateTraits;
+
+template <> struct MMzStateTraits<std::uint64_t> {
+    const static std::size_t MAX_NPCS = 4;
+};
+
+template <> struct MMzStateTraits<Uint128> {
+    const static std::size_t MAX_NPCS = 8;
+};
 
 /**
- * @brief Defines a position of a Mummy Maze game.
+ * @brief Defines a position of a Mummy Maze game, held both as the
+ * packed state and as its hash in the maze, which is its rank (see
+ * BasicMMz::rankOf()) whenever ranks fit in 64 bits.
  */
-class MMzPosition : public Position {
+template <class State>
+class BasicMMzPosition : public Position {
 private:
-    std::uint64_t pos;
+    State pos;
+    std::uint64_t hashValue;
 
 public:
-    MMzPosition(std::uint64_t pos = 0);
-    virtual ~MMzPosition() override;
+    BasicMMzPosition(State pos = 0, std::uint64_t hashValue = 0);
+    virtual ~BasicMMzPosition() override;
 
-    std::uint64_t getPos() const;
+    State getPos() const;
+    void setPos(State pos, std::uint64_t hashValue);
 
     // Position interface
     virtual std::size_t hash() const override;
@@ -39,38 +64,153 @@ public:
     virtual std::string toString() const override;
 };
 
-class MMz : public Puzzle {
+/**
+ * @brief Mummy Maze on grids of up to 32x32 cells, with positions packed
+ * into a STATE. MMz packs up to 4 NPCs into 64 bits and WideMMz up to 8
+ * NPCs into 128 bits.
+ *
+ * Mazes are read from the text format of res/mmz or from the binary
+ * format written by saveBinary(), which holds the walls, gates and items
+ * of every cell and the initial state, so that loading it only maps the
+ * file and builds the tables. The tables never change once a maze is
+ * loaded, so copies of a maze share them.
+ */
+template <class State>
+class BasicMMz : public Puzzle {
+public:
+    typedef BasicMMzPosition<State> PositionType;
+    const static std::size_t MAX_NPCS = MMzStateTraits<State>::MAX_NPCS;
+    const static std::size_t MAX_CELLS = 1024;
+
 private:
+    /**
+     * @brief Precomputed properties of a grid cell, so that moves are
+     * made without decoding locations or reading the world string.
+     */
+    struct Cell {
+        /* Cell reached in each direction, or NO_CELL if a wall blocks
+         * the way. */
+        std::uint16_t dest[MMzMove::NUM_POSSIBLE_MOVES];
+        /* Row and column of the cell in the grid. */
+        std::uint16_t row;
+        std::uint16_t col;
+        /* Bit d is set if a gate lies in direction d. */
+        std::uint8_t gates;
+        /* TRAP_CELL, KEY_CELL and EXIT_CELL flags. */
+        std::uint8_t flags;
+    };
+    const static std::uint16_t NO_CELL = 0xffff;
+    const static std::uint8_t TRAP_CELL = 1;
+    const static std::uint8_t KEY_CELL = 2;
+    const static std::uint8_t EXIT_CELL = 4;
+    /* Set in a chase table entry if the step lands on a key. */
+    const static std::uint16_t CHASE_KEY = 0x8000;
+    struct CellRecord;
+
+    struct Tables {
+        std::vector<Cell> cells;
+        /* Cell an NPC steps to, indexed by gate state, color, NPC cell
+         * and player cell. See chaseIndex(). Left empty if the table is
+         * used from a mapping of a binary maze file. */
+        std::vector<std::uint16_t> chase;
+        std::shared_ptr<const MappedFile> mapping;
+        /* Open cells are the cells characters can reach from their
+         * initial cells. OPENCELLS lists them and CELLINDEX maps a cell
+         * to its index in OPENCELLS, or NO_CELL if it is not open. */
+        std::vector<std::uint16_t> openCells;
+        std::vector<std::uint16_t> cellIndex;
+    };
+
     bool initialized;
     std::size_t rows;
     std::size_t cols;
-    std::size_t worldRows;
-    std::size_t worldCols;
-    std::string world;
-    std::uint64_t initPos;
+    State initPos;
+    std::size_t numNPCs;
+    /* Tables shared by all copies of the maze, and their contents. */
+    std::shared_ptr<const Tables> tables;
+    std::size_t numCells;
+    const Cell *cells;
+    const std::uint16_t *chase;
+    std::size_t numOpenCells;
+    const std::uint16_t *openCells;
+    const std::uint16_t *cellIndex;
+    /* Number of gate states a rank distinguishes, 1 in mazes without
+     * keys and 2 otherwise. */
+    std::uint64_t gateStates;
+    /* Number of ranks, or 0 if they do not fit in 64 bits. */
+    std::uint64_t numRanks;
+    /* Bit i * MAX_NPCS + j is set if NPC slots i < j hold NPCs of equal
+     * strength, which are interchangeable. */
+    std::uint64_t twins;
 
 public:
-    MMz();                              // Construct uninitialized maze.
-    MMz(const std::string &fileName);   // Construct from file.
-    virtual ~MMz() override;
+    BasicMMz();                              // Construct uninitialized maze.
+    BasicMMz(const std::string &fileName);   // Construct from file.
+    virtual ~BasicMMz() override;
 
     bool readFromFile(const std::string &fileName);
-    std::string asString(const MMzPosition* mmzPos) const;
+    bool readFromString(const std::string &text);
+    bool saveBinary(const std::string &fileName) const;
+    std::string asString(const PositionType* mmzPos) const;
+
+    // State interface (see valuesolver.h), with packed states.
+    // Move codes are the MMzMove::PossibleMoves directions.
+    State initialState() const;
+    bool isPrimitiveState(State state) const;
+    virtual std::size_t maxMoves() const override;
+    std::size_t stateMoves(State state, MoveCode *moves) const;
+    State applyMove(State state, MoveCode move) const;
+    State canonicalState(State state) const;
+    virtual std::string moveString(MoveCode move) const override;
 
     // Puzzle interface
     virtual Position *getInitialPosition() const override;
     virtual bool isPrimitivePosition(const Position *pos_) const override;
     virtual std::vector<Move *> getMoves(const Position *pos_) const override;
     virtual Position *doMove(const Position *pos_, const Move *move_) const override;
+    virtual std::size_t getMoveCodes(const Position *pos, MoveCode *moves) const override;
+    virtual void doMove(const Position *pos, MoveCode move, Position *child) const override;
     virtual Puzzle *getCopy() const override;
     virtual std::size_t hashSize() const override;
+    virtual bool hasInjectiveHash() const override;
+    virtual bool unhash(std::size_t hash, Position *pos) const override;
 
-private:
-    std::uint64_t getDestLoc(std::uint64_t pos, std::size_t chrIdx, int direction) const;
-    bool isValidMove(const MMzPosition *mmzPos, const MMzMove *move) const;
+    std::uint64_t rankOf(State state) const;
+    State unrank(std::uint64_t rank) const;
 
-    std::uint64_t moveNPC(uint64_t &pos, std::uint64_t chrIdx, bool &gateToggled) const;
-    bool moveNPCs(std::uint64_t &pos, bool walking, bool &gateToggled) const;
+private:
+    bool parseText(const char *data, std::size_t size, std::vector<CellRecord> &records, State &pos);
+    bool parseBinary(const char *data, std::size_t size, std::vector<CellRecord> &records, State &pos,
+                     const std::uint16_t *&chase);
+    bool load(State pos, const std::vector<CellRecord> &records,
+              const std::shared_ptr<const MappedFile> &mapping, const std::uint16_t *chase);
+    bool buildCells(Tables &tables, const std::vector<CellRecord> &records) const;
+    void buildChase(Tables &tables) const;
+    void buildRanking(Tables &tables);
+    char worldChar(State pos, std::size_t i, std::size_t j, bool showChrs) const;
+    State normalize(State state) const;
+    std::uint64_t hashOf(State state) const;
+    std::size_t chaseIndex(bool gateClosed, bool red, std::uint64_t nloc, std::uint64_t ploc) const;
+    std::uint64_t chaseStep(std::uint64_t nloc, std::uint64_t ploc, bool red, bool gateClosed) const;
+    std::uint64_t getDestLoc(std::uint64_t loc, bool gateClosed, int direction) const;
+    bool isValidMove(State pos, int direction) const;
+
+    bool moveNPCs(State &pos, bool walking, bool &gateToggled) const;
+    bool collect(State &pos, State moved) const;
 };
 
+typedef BasicMMzPosition<std::uint64_t> MMzPosition;
+typedef BasicMMz<std::uint64_t> MMz;
+typedef BasicMMzPosition<Uint128> WideMMzPosition;
+typedef BasicMMz<Uint128> WideMMz;
+
+/**
+ * @brief Mazes are not symmetric in general, and applyMove() already
+ * merges equivalent states, so every state it returns is canonical.
+ */
+template <class State>
+inline State BasicMMz<State>::canonicalState(State state) const {
+    return state;
+}
+
 #endif // MMZ_H
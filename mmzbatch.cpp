@@ -0,0 +1,275 @@
+#include "mmzbatch.h"
+#include "mmz.h"
+#include "parallel.h"
+#include "valuesolver.h"
+#include <algorithm>
+#include <chrono>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#endif
+
+namespace {
+/* Extensions of maze files in the text and the binary format. */
+const char *MAZE_EXTENSION = ".maze";
+const char *BINARY_MAZE_EXTENSION = ".mzb";
+
+template <class PuzzleType>
+void solveMaze(const PuzzleType &mmz, std::size_t memoryLimit, MMzReport &report);
+bool hasExtension(const std::string &name, const char *extension);
+bool hasMazeExtension(const std::string &name);
+bool listDirectory(const std::string &path, std::vector<std::string> &names);
+std::size_t processPeakMemory();
+void writeJsonString(std::ostream &outs, const std::string &str);
+void writeCsvField(std::ostream &outs, const std::string &str);
+} // Anonymous Namespace
+
+MMzBatch::MMzBatch(std::size_t maxThreads, std::size_t memoryLimit) {
+    this->maxThreads = maxThreads;
+    this->memoryLimit = memoryLimit;
+    this->seconds = 0;
+    this->peakResidentMemory = 0;
+}
+
+/**
+ * @brief Adds the maze file PATH to the batch, or all files ending in
+ * ".maze" or ".mzb" in PATH in name order if PATH is a directory.
+ * Returns the number of files added.
+ */
+std::size_t MMzBatch::addPath(const std::string &path) {
+    std::vector<std::string> names;
+    if (!listDirectory(path, names)) {
+        /* Files that cannot be read are reported by run(). */
+        this->fileNames.push_back(path);
+        return 1;
+    }
+    std::sort(names.begin(), names.end());
+    std::size_t count = 0;
+    for (const std::string &name : names) {
+        if (hasMazeExtension(name)) {
+            this->fileNames.push_back(path + "/" + name);
+            ++count;
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Loads and solves every maze added so far, replacing the reports
+ * of any earlier run.
+ */
+void MMzBatch::run() {
+    this->reports.assign(this->fileNames.size(), MMzReport());
+    auto t1 = std::chrono::steady_clock::now();
+    parallelFor(this->fileNames.size(), 1, this->maxThreads,
+                [&](std::size_t begin, std::size_t end, std::size_t) {
+        for (std::size_t i = begin; i < end; ++i) {
+            MMzReport &report = this->reports[i];
+            report.fileName = this->fileNames[i];
+            auto start = std::chrono::steady_clock::now();
+            report.solved = false;
+            /* Mazes with more NPCs than fit in an MMz state fail to load
+             * as an MMz and are solved as a WideMMz. */
+            MMz mmz;
+            WideMMz wideMMz;
+            if ((report.loaded = mmz.readFromFile(report.fileName))) {
+                solveMaze(mmz, this->memoryLimit, report);
+            } else if ((report.loaded = wideMMz.readFromFile(report.fileName))) {
+                solveMaze(wideMMz, this->memoryLimit, report);
+            }
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            report.seconds = elapsed.count();
+        }
+    });
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - t1;
+    this->seconds = elapsed.count();
+    this->peakResidentMemory = processPeakMemory();
+}
+
+const std::vector<MMzReport> &MMzBatch::getReports() const {
+    return this->reports;
+}
+
+/**
+ * @brief Writes one CSV line per maze after a header line. Unsolved
+ * mazes leave the solver columns empty.
+ */
+void MMzBatch::writeCsv(std::ostream &outs) const {
+    outs << "file,status,remoteness,positions,primitives,seconds,peak_bytes\n";
+    for (const MMzReport &report : this->reports) {
+        writeCsvField(outs, report.fileName);
+        if (!report.loaded) {
+            outs << ",invalid,,,," << report.seconds << ",\n";
+        } else if (!report.solved) {
+            outs << ",memory_limit,,,," << report.seconds << ',' << report.peakMemory << '\n';
+        } else {
+            outs << ",solved," << report.remoteness << ',' << report.numPositions << ','
+                 << report.numPrimitives << ',' << report.seconds << ',' << report.peakMemory << '\n';
+        }
+    }
+}
+
+/**
+ * @brief Writes the reports and the summary of the batch as one JSON
+ * object. A remoteness of null means that the maze has no solution.
+ */
+void MMzBatch::writeJson(std::ostream &outs) const {
+    outs << "{\n  \"mazes\": [";
+    for (std::size_t i = 0; i < this->reports.size(); ++i) {
+        const MMzReport &report = this->reports[i];
+        outs << (i ? ",\n" : "\n") << "    {\"file\": ";
+        writeJsonString(outs, report.fileName);
+        if (!report.loaded) {
+            outs << ", \"status\": \"invalid\"";
+        } else if (!report.solved) {
+            outs << ", \"status\": \"memory_limit\", \"peak_bytes\": " << report.peakMemory;
+        } else {
+            outs << ", \"status\": \"solved\", \"remoteness\": ";
+            if (report.remoteness < 0) {
+                outs << "null";
+            } else {
+                outs << report.remoteness;
+            }
+            outs << ", \"positions\": " << report.numPositions
+                 << ", \"primitives\": " << report.numPrimitives
+                 << ", \"peak_bytes\": " << report.peakMemory;
+        }
+        outs << ", \"seconds\": " << report.seconds << '}';
+    }
+    outs << "\n  ],\n  \"summary\": {\"mazes\": " << this->reports.size()
+         << ", \"solved\": " << numSolved()
+         << ", \"seconds\": " << this->seconds
+         << ", \"mazes_per_second\": " << (this->seconds > 0 ? this->reports.size() / this->seconds : 0)
+         << ", \"peak_resident_bytes\": " << this->peakResidentMemory << "}\n}\n";
+}
+
+void MMzBatch::printSummary(std::ostream &outs) const {
+    outs << "solved " << numSolved() << " of " << this->reports.size() << " mazes in "
+         << this->seconds << " s (" << (this->seconds > 0 ? this->reports.size() / this->seconds : 0)
+         << " mazes per second), peak resident memory " << this->peakResidentMemory
+         << " bytes" << std::endl;
+}
+
+std::size_t MMzBatch::numSolved() const {
+    std::size_t count = 0;
+    for (const MMzReport &report : this->reports) {
+        count += report.solved;
+    }
+    return count;
+}
+
+namespace {
+/**
+ * @brief Solves the loaded maze MMZ into REPORT, giving up once the
+ * solver takes more than MEMORYLIMIT bytes.
+ */
+template <class PuzzleType>
+void solveMaze(const PuzzleType &mmz, std::size_t memoryLimit, MMzReport &report) {
+    ValueSolver<PuzzleType> solver(mmz);
+    solver.setMemoryLimit(memoryLimit);
+    int rmt = solver.solve();
+    report.solved = rmt >= 0;
+    report.remoteness = rmt == ValueSolver<PuzzleType>::RMT_MAX ? -1 : rmt;
+    report.numPositions = solver.numPositions();
+    report.numPrimitives = solver.numPrimitives();
+    report.peakMemory = solver.peakMemoryUsage();
+}
+
+bool hasExtension(const std::string &name, const char *extension) {
+    std::size_t length = std::char_traits<char>::length(extension);
+    return name.size() > length && name.compare(name.size() - length, length, extension) == 0;
+}
+
+bool hasMazeExtension(const std::string &name) {
+    return hasExtension(name, MAZE_EXTENSION) || hasExtension(name, BINARY_MAZE_EXTENSION);
+}
+
+/**
+ * @brief Writes the names of the entries of directory PATH to NAMES.
+ * Returns false if PATH is not a readable directory.
+ */
+#ifdef _WIN32
+bool listDirectory(const std::string &path, std::vector<std::string> &names) {
+    WIN32_FIND_DATAA entry;
+    HANDLE find = FindFirstFileA((path + "\\*").c_str(), &entry);
+    if (find == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    do {
+        if (!(entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+            names.push_back(entry.cFileName);
+        }
+    } while (FindNextFileA(find, &entry));
+    FindClose(find);
+    return true;
+}
+
+std::size_t processPeakMemory() {
+    /* Not tracked on this platform. */
+    return 0;
+}
+#else
+bool listDirectory(const std::string &path, std::vector<std::string> &names) {
+    DIR *dir = opendir(path.c_str());
+    if (!dir) {
+        return false;
+    }
+    while (dirent *entry = readdir(dir)) {
+        struct stat info;
+        std::string name = entry->d_name;
+        if (stat((path + "/" + name).c_str(), &info) == 0 && S_ISREG(info.st_mode)) {
+            names.push_back(name);
+        }
+    }
+    closedir(dir);
+    return true;
+}
+
+std::size_t processPeakMemory() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return usage.ru_maxrss;
+#else
+    /* Linux reports kilobytes. */
+    return static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+#endif
+}
+#endif
+
+void writeJsonString(std::ostream &outs, const std::string &str) {
+    const char *HEX = "0123456789abcdef";
+    outs << '"';
+    for (char c : str) {
+        if (c == '"' || c == '\\') {
+            outs << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            outs << "\\u00" << HEX[(c >> 4) & 0xf] << HEX[c & 0xf];
+        } else {
+            outs << c;
+        }
+    }
+    outs << '"';
+}
+
+/* Quotes STR if it contains a separator, a quote or a line break. */
+void writeCsvField(std::ostream &outs, const std::string &str) {
+    if (str.find_first_of(",\"\r\n") == std::string::npos) {
+        outs << str;
+        return;
+    }
+    outs << '"';
+    for (char c : str) {
+        if (c == '"') {
+            outs << '"';
+        }
+        outs << c;
+    }
+    outs << '"';
+}
+} // Anonymous Namespace
@@ -0,0 +1,62 @@
+#ifndef MMZBATCH_H
+#define MMZBATCH_H
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Result of solving one maze file of a batch.
+ */
+struct MMzReport {
+    std::string fileName;
+    /* False if the file could not be read as a maze. */
+    bool loaded;
+    /* False if the maze was not loaded or its solver exceeded the memory
+     * limit. The fields below are only meaningful if it is true. */
+    bool solved;
+    /* Remoteness of the initial position, or -1 if there is no solution. */
+    int remoteness;
+    std::size_t numPositions;
+    std::size_t numPrimitives;
+    /* Time spent loading and solving the maze. */
+    double seconds;
+    /* Peak number of bytes held by the solver tables. */
+    std::size_t peakMemory;
+};
+
+/**
+ * @brief Loads and solves a batch of Mummy Maze files.
+ *
+ * Mazes are handed out one at a time to at most MAXTHREADS threads, or
+ * numWorkers() threads if MAXTHREADS is 0 or larger, each of which
+ * loads its maze and solves it with a ValueSolver, as a WideMMz if it has
+ * more NPCs than fit in an MMz. A memory
+ * limit may be set for the solver of each maze; mazes whose solver
+ * exceeds it are reported as unsolved and do not stop the batch.
+ */
+class MMzBatch {
+private:
+    std::size_t maxThreads;
+    std::size_t memoryLimit;
+    std::vector<std::string> fileNames;
+    std::vector<MMzReport> reports;
+    double seconds;
+    std::size_t peakResidentMemory;
+
+public:
+    MMzBatch(std::size_t maxThreads = 0, std::size_t memoryLimit = 0);
+
+    std::size_t addPath(const std::string &path);
+    void run();
+
+    const std::vector<MMzReport> &getReports() const;
+    void writeCsv(std::ostream &outs) const;
+    void writeJson(std::ostream &outs) const;
+    void printSummary(std::ostream &outs) const;
+
+private:
+    std::size_t numSolved() const;
+};
+
+#endif // MMZBATCH_H
@@ -0,0 +1,566 @@
+#include "mmzgenerator.h"
+#include "mmz.h"
+#include "parallel.h"
+#include "valuesolver.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <thread>
+
+namespace {
+const char WALL   = 'W';
+const char OPEN   = ' ';
+const char EMPTY  = '_';
+const char GATE   = 'G';
+const char KEY    = 'K';
+const char TRAP   = 'T';
+const char EXIT   = 'E';
+const char PLAYER = '4';
+
+/* Layouts drawn by the producer per seed before it gives up on the
+ * parameters. */
+const std::size_t MAX_DRAWS_PER_SEED = 1000;
+
+typedef std::mt19937_64 Rng;
+
+/* Kinds of random streams, so that no two streams share a seed. */
+enum Stream {LAYOUTS, CLIMB};
+
+/**
+ * @brief Maze in the text format, without its size line and line breaks.
+ */
+struct Layout {
+    std::size_t rows;
+    std::size_t cols;
+    std::size_t worldRows;
+    std::size_t worldCols;
+    std::string world;
+
+    std::size_t worldLoc(std::size_t loc) const {
+        return (2 * (loc / this->cols) + 1) * this->worldCols + 2 * (loc % this->cols) + 1;
+    }
+
+    std::string toText() const {
+        std::stringstream ss;
+        ss << this->rows << ' ' << this->cols << '\n';
+        for (std::size_t i = 0; i < this->worldRows; ++i) {
+            ss.write(this->world.data() + i * this->worldCols, this->worldCols);
+            ss.put('\n');
+        }
+        return ss.str();
+    }
+};
+
+/**
+ * @brief Layout handed to a worker, with its index among all seed layouts
+ * of the generator.
+ */
+struct SeedLayout {
+    std::size_t index;
+    Layout layout;
+};
+
+/**
+ * @brief Parameters of the random layouts.
+ */
+struct Params {
+    std::size_t rows;
+    std::size_t cols;
+    std::string npcs;
+    std::size_t numTraps;
+    bool useGate;
+    double wallDensity;
+    /* World locations of the edges between two cells. */
+    std::vector<std::size_t> edges;
+};
+
+/**
+ * @brief Queue of at most CAPACITY items between producer and consumer
+ * threads.
+ */
+template <class T>
+class BoundedQueue {
+private:
+    std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    std::deque<T> items;
+    std::size_t capacity;
+    bool closed;
+
+public:
+    explicit BoundedQueue(std::size_t capacity) : capacity(capacity), closed(false) {}
+
+    /* Waits until there is room for ITEM. */
+    void push(T item) {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->notFull.wait(lock, [this] { return this->items.size() < this->capacity; });
+        this->items.push_back(std::move(item));
+        this->notEmpty.notify_one();
+    }
+
+    /* Waits for an item. Returns false once the queue is closed and
+     * empty. */
+    bool pop(T &item) {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->notEmpty.wait(lock, [this] { return !this->items.empty() || this->closed; });
+        if (this->items.empty()) {
+            return false;
+        }
+        item = std::move(this->items.front());
+        this->items.pop_front();
+        this->notFull.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->closed = true;
+        this->notEmpty.notify_all();
+    }
+};
+
+/**
+ * @brief Maze and solver of type PUZZLETYPE that a worker reuses, buffers
+ * included, for all its candidates.
+ */
+template <class PuzzleType>
+class LevelSolver {
+private:
+    PuzzleType mmz;
+    ValueSolver<PuzzleType> solver;
+
+public:
+    LevelSolver() : solver(mmz) {
+        this->solver.setKeepBuffers(true);
+    }
+
+    /* Solves the maze in TEXT into RMT, as returned by
+     * ValueSolver::solve(), and NUMPOSITIONS. Returns false if TEXT does
+     * not hold a valid maze. */
+    bool solve(const std::string &text, int &rmt, std::size_t &numPositions) {
+        if (!this->mmz.readFromString(text)) {
+            return false;
+        }
+        this->solver.reset(this->mmz);
+        rmt = this->solver.solve();
+        numPositions = this->solver.numPositions();
+        return true;
+    }
+};
+
+Rng makeRng(std::uint64_t seed, Stream stream, std::uint64_t index);
+std::vector<std::size_t> interiorEdges(std::size_t rows, std::size_t cols);
+Layout randomLayout(const Params &params, Rng &rng);
+void mutate(Layout &layout, const Params &params, Rng &rng);
+bool exitReachable(const Layout &layout);
+} // Anonymous Namespace
+
+MMzGenerator::MMzGenerator(std::size_t rows, std::size_t cols) {
+    this->rows = rows;
+    this->cols = cols;
+    this->npcs = "2";
+    this->numTraps = 0;
+    this->useGate = false;
+    this->wallDensity = 0.35;
+    this->targetRemoteness = 40;
+    this->climbSteps = 200;
+    this->numKept = 10;
+    this->maxThreads = 0;
+    this->seed = 1;
+    this->numClimbs = 0;
+    this->numLayouts = 0;
+    this->numRejectedLayouts = 0;
+    this->numRejectedMutations = 0;
+    this->numSolves = 0;
+    this->numUnsolvable = 0;
+    this->seconds = 0;
+}
+
+/**
+ * @brief Sets the NPCs of every layout, one character per NPC in the text
+ * format: '0' and '1' for white and red scorpions, '2' and '3' for white
+ * and red mummies.
+ */
+void MMzGenerator::setNPCs(const std::string &npcs) {
+    this->npcs = npcs;
+}
+
+void MMzGenerator::setNumTraps(std::size_t numTraps) {
+    this->numTraps = numTraps;
+}
+
+/**
+ * @brief Sets whether every layout has a gate and a key that toggles it.
+ */
+void MMzGenerator::setUseGate(bool useGate) {
+    this->useGate = useGate;
+}
+
+/**
+ * @brief Sets the probability that an edge between two cells of a random
+ * layout holds a wall.
+ */
+void MMzGenerator::setWallDensity(double density) {
+    this->wallDensity = density;
+}
+
+/**
+ * @brief Sets the remoteness at which a climb stops.
+ */
+void MMzGenerator::setTargetRemoteness(int rmt) {
+    this->targetRemoteness = rmt;
+}
+
+void MMzGenerator::setClimbSteps(std::size_t steps) {
+    this->climbSteps = steps;
+}
+
+/**
+ * @brief Sets the number of hardest levels kept.
+ */
+void MMzGenerator::setNumKept(std::size_t numKept) {
+    this->numKept = numKept;
+}
+
+/**
+ * @brief Sets the number of worker threads, or numWorkers() if 0.
+ */
+void MMzGenerator::setMaxThreads(std::size_t maxThreads) {
+    this->maxThreads = maxThreads;
+}
+
+void MMzGenerator::setSeed(std::uint64_t seed) {
+    this->seed = seed;
+}
+
+/**
+ * @brief Climbs from NUMSEEDS random layouts, adding the results to the
+ * levels kept from earlier runs.
+ *
+ * The layouts and each climb draw from their own random streams, derived
+ * from the seed and the index of the seed layout, so the levels found
+ * depend on the seed but not on the number of threads or on which
+ * thread climbs which layout.
+ */
+void MMzGenerator::run(std::size_t numSeeds) {
+    Params params;
+    params.rows = this->rows;
+    params.cols = this->cols;
+    params.npcs = this->npcs;
+    params.numTraps = this->numTraps;
+    params.useGate = this->useGate;
+    params.wallDensity = this->wallDensity;
+    params.edges = interiorEdges(this->rows, this->cols);
+    if (this->rows * this->cols < params.npcs.size() + params.numTraps + 3 ||
+            this->rows * this->cols > MMz::MAX_CELLS || params.npcs.size() > WideMMz::MAX_NPCS) {
+        /* Characters and items do not fit. */
+        return;
+    }
+
+    std::size_t workers = this->maxThreads ? this->maxThreads : numWorkers();
+    BoundedQueue<SeedLayout> queue(2 * workers);
+    std::atomic<std::size_t> rejectedMutations(0);
+    std::atomic<std::size_t> solves(0);
+    std::atomic<std::size_t> unsolvable(0);
+    std::mutex levelsMutex;
+    auto offer = [&](const MMzLevel &level) {
+        std::lock_guard<std::mutex> lock(levelsMutex);
+        for (std::size_t i = 0; i < this->levels.size(); ++i) {
+            if (this->levels[i].text == level.text) {
+                if (this->levels[i].seedIndex < level.seedIndex) {
+                    return;
+                }
+                this->levels.erase(this->levels.begin() + i);
+                break;
+            }
+        }
+        /* Ties go to the earlier seed, whatever order climbs end in. */
+        auto pos = std::upper_bound(this->levels.begin(), this->levels.end(), level,
+                                    [](const MMzLevel &a, const MMzLevel &b) {
+            return a.remoteness > b.remoteness || (a.remoteness == b.remoteness && a.seedIndex < b.seedIndex);
+        });
+        this->levels.insert(pos, level);
+        if (this->levels.size() > this->numKept) {
+            this->levels.pop_back();
+        }
+    };
+
+    /* Layouts with more NPCs than fit in an MMz state are solved as a
+     * WideMMz. */
+    bool wide = params.npcs.size() > MMz::MAX_NPCS;
+    auto consume = [&]() {
+        LevelSolver<MMz> mmzSolver;
+        LevelSolver<WideMMz> wideSolver;
+        /* Solves LAYOUT into LEVEL and returns whether it is solvable. */
+        auto evaluate = [&](const Layout &layout, MMzLevel &level) {
+            ++solves;
+            level.text = layout.toText();
+            int rmt;
+            std::size_t numPositions;
+            if (!(wide ? wideSolver.solve(level.text, rmt, numPositions)
+                       : mmzSolver.solve(level.text, rmt, numPositions))) {
+                return false;
+            } else if (rmt < 0 || rmt == ValueSolver<MMz>::RMT_MAX) {
+                ++unsolvable;
+                return false;
+            }
+            level.remoteness = rmt;
+            level.numPositions = numPositions;
+            return true;
+        };
+
+        SeedLayout item;
+        while (queue.pop(item)) {
+            Rng rng = makeRng(this->seed, CLIMB, item.index);
+            Layout &current = item.layout;
+            MMzLevel best;
+            if (!evaluate(current, best)) {
+                continue;
+            }
+            best.seedIndex = item.index;
+            for (std::size_t step = 0; step < this->climbSteps && best.remoteness < this->targetRemoteness; ++step) {
+                Layout candidate = current;
+                mutate(candidate, params, rng);
+                if (!exitReachable(candidate)) {
+                    ++rejectedMutations;
+                    continue;
+                }
+                MMzLevel level;
+                level.seedIndex = item.index;
+                /* Sideways moves let the climb cross plateaus. */
+                if (evaluate(candidate, level) && level.remoteness >= best.remoteness) {
+                    current = std::move(candidate);
+                    best = std::move(level);
+                }
+            }
+            offer(best);
+        }
+    };
+
+    auto t1 = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < workers; ++i) {
+        threads.emplace_back(consume);
+    }
+    /* The calling thread is the producer. Runs continue the layout
+     * stream where earlier runs left it. */
+    Rng rng = makeRng(this->seed, LAYOUTS, this->numClimbs);
+    std::size_t produced = 0;
+    for (std::size_t draws = 0; produced < numSeeds && draws < numSeeds * MAX_DRAWS_PER_SEED; ++draws) {
+        SeedLayout item;
+        item.layout = randomLayout(params, rng);
+        ++this->numLayouts;
+        if (!exitReachable(item.layout)) {
+            ++this->numRejectedLayouts;
+            continue;
+        }
+        item.index = this->numClimbs + produced;
+        queue.push(std::move(item));
+        ++produced;
+    }
+    queue.close();
+    for (std::thread &t : threads) {
+        t.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - t1;
+    this->seconds += elapsed.count();
+    this->numClimbs += produced;
+    this->numRejectedMutations += rejectedMutations;
+    this->numSolves += solves;
+    this->numUnsolvable += unsolvable;
+}
+
+const std::vector<MMzLevel> &MMzGenerator::getLevels() const {
+    return this->levels;
+}
+
+/**
+ * @brief Writes the levels kept, hardest first, to files gen_000.maze,
+ * gen_001.maze and so on in DIRECTORY. Returns false if a file cannot be
+ * written.
+ */
+bool MMzGenerator::saveLevels(const std::string &directory) const {
+    for (std::size_t i = 0; i < this->levels.size(); ++i) {
+        std::string number = std::to_string(i);
+        std::string fileName = directory + "/gen_" + std::string(number.size() < 3 ? 3 - number.size() : 0, '0') +
+                number + ".maze";
+        std::ofstream of(fileName);
+        of << this->levels[i].text;
+        of.close();
+        if (of.fail()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void MMzGenerator::printSummary(std::ostream &outs) const {
+    std::size_t reached = 0;
+    for (const MMzLevel &level : this->levels) {
+        reached += level.remoteness >= this->targetRemoteness;
+    }
+    outs << "drew " << this->numLayouts << " layouts and rejected " << this->numRejectedLayouts
+         << " of them early, climbed from " << this->numClimbs << ", rejected "
+         << this->numRejectedMutations << " mutations early and solved " << this->numSolves
+         << " layouts (" << this->numUnsolvable
+         << " unsolvable) in " << this->seconds << " s ("
+         << (this->seconds > 0 ? this->numSolves / this->seconds : 0) << " solves per second)\n";
+    outs << "kept " << this->levels.size() << " levels, " << reached << " at remoteness "
+         << this->targetRemoteness << " or more";
+    if (!this->levels.empty()) {
+        outs << ", hardest at remoteness " << this->levels.front().remoteness;
+    }
+    outs << std::endl;
+}
+
+namespace {
+/**
+ * @brief Returns a generator for random stream STREAM number INDEX of
+ * SEED.
+ */
+Rng makeRng(std::uint64_t seed, Stream stream, std::uint64_t index) {
+    std::seed_seq seq{std::uint32_t(seed), std::uint32_t(seed >> 32), std::uint32_t(stream),
+                      std::uint32_t(index), std::uint32_t(index >> 32)};
+    return Rng(seq);
+}
+
+std::vector<std::size_t> interiorEdges(std::size_t rows, std::size_t cols) {
+    std::size_t worldRows = 2 * rows + 1;
+    std::size_t worldCols = 2 * cols + 1;
+    std::vector<std::size_t> edges;
+    for (std::size_t i = 1; i + 1 < worldRows; ++i) {
+        for (std::size_t j = 1; j + 1 < worldCols; ++j) {
+            if ((i + j) % 2) {
+                edges.push_back(i * worldCols + j);
+            }
+        }
+    }
+    return edges;
+}
+
+/**
+ * @brief Returns a random layout with border walls, the exit, the player,
+ * the NPCs, the traps and, if requested, a key and a gate.
+ */
+Layout randomLayout(const Params &params, Rng &rng) {
+    Layout layout;
+    layout.rows = params.rows;
+    layout.cols = params.cols;
+    layout.worldRows = 2 * params.rows + 1;
+    layout.worldCols = 2 * params.cols + 1;
+    layout.world.assign(layout.worldRows * layout.worldCols, OPEN);
+    for (std::size_t i = 0; i < layout.worldRows; ++i) {
+        for (std::size_t j = 0; j < layout.worldCols; ++j) {
+            bool border = i == 0 || j == 0 || i + 1 == layout.worldRows || j + 1 == layout.worldCols;
+            if (border) {
+                layout.world[i * layout.worldCols + j] = WALL;
+            } else if (i % 2 && j % 2) {
+                layout.world[i * layout.worldCols + j] = EMPTY;
+            }
+        }
+    }
+    std::bernoulli_distribution wall(params.wallDensity);
+    for (std::size_t edge : params.edges) {
+        if (wall(rng)) {
+            layout.world[edge] = WALL;
+        }
+    }
+
+    std::vector<std::size_t> locs(params.rows * params.cols);
+    for (std::size_t loc = 0; loc < locs.size(); ++loc) {
+        locs[loc] = loc;
+    }
+    std::shuffle(locs.begin(), locs.end(), rng);
+    std::size_t next = 0;
+    layout.world[layout.worldLoc(locs[next++])] = EXIT;
+    layout.world[layout.worldLoc(locs[next++])] = PLAYER;
+    for (char npc : params.npcs) {
+        layout.world[layout.worldLoc(locs[next++])] = npc;
+    }
+    for (std::size_t i = 0; i < params.numTraps; ++i) {
+        layout.world[layout.worldLoc(locs[next++])] = TRAP;
+    }
+    if (params.useGate) {
+        layout.world[layout.worldLoc(locs[next++])] = KEY;
+        std::uniform_int_distribution<std::size_t> edge(0, params.edges.size() - 1);
+        layout.world[params.edges[edge(rng)]] = GATE;
+    }
+    return layout;
+}
+
+/**
+ * @brief Toggles the wall of a random edge or moves the content of a
+ * random occupied cell to a random empty cell.
+ */
+void mutate(Layout &layout, const Params &params, Rng &rng) {
+    if (std::bernoulli_distribution(0.5)(rng)) {
+        std::uniform_int_distribution<std::size_t> pick(0, params.edges.size() - 1);
+        for (;;) {
+            char &edge = layout.world[params.edges[pick(rng)]];
+            if (edge != GATE) {
+                edge = edge == WALL ? OPEN : WALL;
+                return;
+            }
+        }
+    }
+    std::vector<std::size_t> occupied;
+    std::vector<std::size_t> empty;
+    for (std::size_t loc = 0; loc < layout.rows * layout.cols; ++loc) {
+        (layout.world[layout.worldLoc(loc)] == EMPTY ? empty : occupied).push_back(loc);
+    }
+    if (empty.empty()) {
+        return;
+    }
+    std::size_t from = layout.worldLoc(occupied[std::uniform_int_distribution<std::size_t>(0, occupied.size() - 1)(rng)]);
+    std::size_t to = layout.worldLoc(empty[std::uniform_int_distribution<std::size_t>(0, empty.size() - 1)(rng)]);
+    std::swap(layout.world[from], layout.world[to]);
+}
+
+/**
+ * @brief Returns whether the player can walk to the exit when NPCs are
+ * ignored, gates are open and traps are avoided. Layouts that fail this
+ * check are unsolvable.
+ */
+bool exitReachable(const Layout &layout) {
+    std::size_t numCells = layout.rows * layout.cols;
+    std::size_t start = numCells;
+    for (std::size_t loc = 0; loc < numCells; ++loc) {
+        if (layout.world[layout.worldLoc(loc)] == PLAYER) {
+            start = loc;
+        }
+    }
+    if (start == numCells) {
+        return false;
+    }
+    std::vector<bool> seen(numCells, false);
+    std::vector<std::size_t> queue(1, start);
+    seen[start] = true;
+    const int I_OFS[4] = {-1, 0, 1, 0};
+    const int J_OFS[4] = {0, -1, 0, 1};
+    for (std::size_t next = 0; next < queue.size(); ++next) {
+        std::size_t loc = queue[next];
+        std::size_t worldLoc = layout.worldLoc(loc);
+        if (layout.world[worldLoc] == EXIT) {
+            return true;
+        }
+        for (int d = 0; d < 4; ++d) {
+            if (layout.world[worldLoc + I_OFS[d] * layout.worldCols + J_OFS[d]] == WALL) {
+                continue;
+            }
+            std::size_t dest = loc + I_OFS[d] * layout.cols + J_OFS[d];
+            if (!seen[dest] && layout.world[layout.worldLoc(dest)] != TRAP) {
+                seen[dest] = true;
+                queue.push_back(dest);
+            }
+        }
+    }
+    return false;
+}
+} // Anonymous Namespace
@@ -0,0 +1,82 @@
+#ifndef MMZGENERATOR_H
+#define MMZGENERATOR_H
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief A generated maze in the text format of res/mmz.
+ */
+struct MMzLevel {
+    std::string text;
+    /* Remoteness of the initial position. */
+    int remoteness;
+    std::size_t numPositions;
+    /* Index of the random layout the level was climbed from. */
+    std::size_t seedIndex;
+};
+
+/**
+ * @brief Generates Mummy Maze levels and keeps the hardest ones.
+ *
+ * One producer thread draws random layouts of walls, traps, an optional
+ * gate and key, the exit and the characters, and hands those whose exit
+ * the player can reach at all to a pool of worker threads through a
+ * bounded queue. Each worker solves its layout and then climbs: it
+ * applies a random mutation, such as toggling a wall or moving a
+ * character, and keeps the mutated layout if it is still solvable and at
+ * least as hard. A climb ends once the layout reaches the target
+ * remoteness or after a given number of steps. Every worker reuses one
+ * maze and one solver, buffers included, for all its candidates.
+ */
+class MMzGenerator {
+private:
+    std::size_t rows;
+    std::size_t cols;
+    /* Characters of the NPCs placed in every layout, such as "23". */
+    std::string npcs;
+    std::size_t numTraps;
+    bool useGate;
+    double wallDensity;
+    int targetRemoteness;
+    std::size_t climbSteps;
+    std::size_t numKept;
+    std::size_t maxThreads;
+    std::uint64_t seed;
+
+    /* Hardest levels found, hardest first. */
+    std::vector<MMzLevel> levels;
+    /* Seed layouts climbed from, which also numbers the next one. */
+    std::size_t numClimbs;
+    /* Random layouts drawn, and those rejected before any solve. */
+    std::size_t numLayouts;
+    std::size_t numRejectedLayouts;
+    /* Mutated layouts rejected before any solve. */
+    std::size_t numRejectedMutations;
+    std::size_t numSolves;
+    std::size_t numUnsolvable;
+    double seconds;
+
+public:
+    MMzGenerator(std::size_t rows = 6, std::size_t cols = 6);
+
+    void setNPCs(const std::string &npcs);
+    void setNumTraps(std::size_t numTraps);
+    void setUseGate(bool useGate);
+    void setWallDensity(double density);
+    void setTargetRemoteness(int rmt);
+    void setClimbSteps(std::size_t steps);
+    void setNumKept(std::size_t numKept);
+    void setMaxThreads(std::size_t maxThreads);
+    void setSeed(std::uint64_t seed);
+
+    void run(std::size_t numSeeds);
+
+    const std::vector<MMzLevel> &getLevels() const;
+    bool saveLevels(const std::string &directory) const;
+    void printSummary(std::ostream &outs) const;
+};
+
+#endif // MMZGENERATOR_H
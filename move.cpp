@@ -1,5 +1,14 @@
 #include "move.h"
+#include "slabpool.h"
 
 Move::Move() {}
 
 Move::~Move() {}
+
+void *Move::operator new(std::size_t size) {
+    return slabAllocate(size);
+}
+
+void Move::operator delete(void *ptr, std::size_t size) {
+    slabDeallocate(ptr, size);
+}
@@ -1,12 +1,24 @@
 #ifndef MOVE_H
 #define MOVE_H
+#include <cstddef>
+#include <cstdint>
 #include <string>
 
+/**
+ * @brief Compact puzzle-specific encoding of a move, used by the
+ * value-typed puzzle interface (see valuesolver.h).
+ */
+typedef std::uint32_t MoveCode;
+
 class Move {
 public:
     Move();
     virtual ~Move() = 0;
 
+    /* Objects of all subclasses are allocated from the slab pool. */
+    static void *operator new(std::size_t size);
+    static void operator delete(void *ptr, std::size_t size);
+
     virtual std::string toString() const = 0;
 };
 
@@ -1,122 +1,639 @@
 #include "optsolver.h"
-#include <fstream>
-#include <queue>
-#include <unordered_set>
+#include "csrgraph.h"
+#include "parallel.h"
+#include "slabpool.h"
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace {
+/* Number of 64-bit table words handed to a worker at a time. */
+const std::size_t TABLE_GRAIN = 256;
+/* Number of positions handed to a worker at a time. */
+const std::size_t STATE_GRAIN = 64;
+
+/* Database layout, in native byte order:
+ *     DbHeader, zero padding up to DATAOFFSET,
+ *     DATASIZE bytes of packed codes,
+ *     OVERFLOWCOUNT DbOverflowEntry records.
+ * The packed codes start on a page boundary so that they can be used
+ * straight from a mapping of the file. */
+const char DB_MAGIC[8] = {'P', 'Z', 'S', 'O', 'L', 'V', 'D', 'B'};
+const std::uint32_t DB_VERSION = 1;
+const std::uint32_t DB_BYTE_ORDER = 0x01020304;
+const std::uint64_t DB_DATA_OFFSET = 4096;
 
-typedef std::queue<Position *> PositionQueue;
-typedef std::vector<Move *> MoveVector;
+struct DbHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byteOrder;
+    std::uint32_t encoding;
+    std::int32_t rmt;
+    std::uint64_t hashSize;
+    std::uint64_t dataOffset;
+    std::uint64_t dataSize;
+    std::uint64_t overflowCount;
+    /* Puzzle::getId(), NUL-terminated. */
+    char puzzleId[64];
+};
 
-OptSolver::OptSolver(const Puzzle *puzzle) {
+struct DbOverflowEntry {
+    std::uint64_t hash;
+    std::int32_t rmt;
+    std::int32_t padding;
+};
+
+std::size_t tableSize(std::size_t hashSize, std::size_t bitsPerSlot) {
+    return (hashSize * bitsPerSlot + 7) / 8;
+}
+
+/* Index of the lowest set bit of nonzero WORD. */
+inline std::size_t lowestBit(std::uint64_t word) {
+    return __builtin_ctzll(word);
+}
+
+/* Converts between a table word as stored and the word whose byte I,
+ * counted from the least significant, is byte I of the table. */
+inline std::uint64_t tableOrder(std::uint64_t word) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    word = __builtin_bswap64(word);
+#endif
+    return word;
+}
+
+/* Loads table word WORD in table order while other workers may be
+ * claiming slots in it. */
+inline std::uint64_t loadWord(const std::uint64_t *word) {
+    return tableOrder(__atomic_load_n(word, __ATOMIC_RELAXED));
+}
+
+/* Returns a mask with the lowest bit of every BITS-bit field of WORD set
+ * if the field equals the corresponding field of PATTERN. */
+inline std::uint64_t matchFields(std::uint64_t word, std::uint64_t pattern, std::size_t bits) {
+    std::uint64_t diff = word ^ pattern;
+    for (std::size_t shift = 1; shift < bits; shift <<= 1) {
+        diff |= diff >> shift;
+    }
+    return ~diff & (~std::uint64_t(0) / ((std::uint64_t(1) << bits) - 1));
+}
+}
+
+OptSolver::OptSolver(const Puzzle *puzzle, Encoding encoding) {
     std::size_t hashSize = puzzle->hashSize();
-    this->valid = hashSize > 0;
     this->solved = false;
     this->puzzle = puzzle->getCopy();
+    /* Positions are rebuilt from their hashes while solving. */
+    Position *initPos = puzzle->getInitialPosition();
+    this->valid = hashSize > 0 && puzzle->unhash(initPos->hash(), initPos) &&
+            (encoding != MOD3 || puzzle->isReversible());
+    delete initPos;
+    this->encoding = encoding;
     if (this->valid) {
-        this->data = new char[hashSize];
-        for (std::size_t i = 0; i < hashSize; ++i) {
-            this->data[i] = -1;
-        }
+        /* All ones is the unreached code in every encoding. Whole words
+         * are allocated so that solve() can scan the table by word. */
+        this->data.assign((tableSize(hashSize, encoding) + 7) / 8, ~std::uint64_t(0));
     }
+    this->table = reinterpret_cast<const std::uint8_t *>(this->data.data());
 }
 
-OptSolver::OptSolver(const OptSolver &other) {
+OptSolver::OptSolver(const OptSolver &other) :
+        data(other.data), mapping(other.mapping), overflow(other.overflow) {
+    this->table = this->mapping ? other.table : reinterpret_cast<const std::uint8_t *>(this->data.data());
     this->valid = other.valid;
     this->solved = other.solved;
     this->puzzle = other.puzzle->getCopy();
-    if (other.solved) {
-        std::size_t hashSize = this->puzzle->hashSize();
-        this->data = new char[hashSize];
-        for (std::size_t i = 0; i < hashSize; ++i) {
-            this->data[i] = other.data[i];
-        }
-    }
+    this->encoding = other.encoding;
+    this->rmt = other.rmt;
 }
 
 OptSolver::~OptSolver() {
     delete this->puzzle;
-    if (this->valid) {
-        delete[] this->data;
-    }
 }
 
+/**
+ * @brief Returns the largest distance from the initial position in a
+ * reversible puzzle, the remoteness of the initial position in any other
+ * puzzle, or -1 if the puzzle cannot be solved by this solver or its
+ * initial position cannot reach a primitive position.
+ */
 int OptSolver::solve() {
     if (!this->valid) {
         return -1;
     } else if (!this->solved) {
-        this->rmt = -1;
-        PositionQueue fringe;
-        fringe.push(this->puzzle->getInitialPosition());
-        char rmt = 0;
-        std::size_t remPosInQueue = 1;
-        std::size_t numPosNextLevel = 0;
-        while (fringe.size()) {
-            Position *currPos = fringe.front();
-            fringe.pop();
-            if (data[currPos->hash()] == -1) {
-                data[currPos->hash()] = rmt;
-                if (rmt > this->rmt) {
-                    this->rmt = rmt;
+        searchForward();
+        if (!this->puzzle->isReversible()) {
+            searchBackward();
+        }
+        /* Release the slabs of the positions rebuilt from hashes. */
+        slabTrim();
+        this->solved = true;
+    }
+    return this->rmt;
+}
+
+void OptSolver::searchForward() {
+    /* Level-synchronous BFS with no frontier other than the table
+     * itself. At each level, the workers scan disjoint ranges of table
+     * words for the slots whose code is that of the current distance,
+     * rebuild each position from its hash and claim its unreached
+     * children by writing the code of the next distance with a byte
+     * compare-and-swap. The codes of two consecutive distances differ,
+     * so claimed children are not mistaken for the current frontier.
+     * The positions of a table word are expanded with a single call to
+     * Puzzle::expandHashes() when the puzzle supports it.
+     *
+     * A PACKED code names a single distance, but a MOD3 code is shared
+     * by every third distance, so a scan would expand all earlier levels
+     * with the same residue again. MOD3 frontiers are therefore listed:
+     * the workers collect the hashes they claim, and the lists become
+     * the next frontier once the level is done. So are the frontiers of
+     * distances past the largest code of a PACKED encoding, which are
+     * also moved into the overflow table. */
+    std::size_t numWords = this->data.size();
+    std::size_t slotsPerWord = 64 / this->encoding;
+    std::uint64_t fieldMask = ~std::uint64_t(0) / unreachedCode();
+    unsigned overflowCode = unreachedCode() - 1;
+
+    std::size_t workers = numWorkers();
+    std::size_t maxMoves = this->puzzle->maxMoves();
+    std::vector<MoveCode> moves(workers * maxMoves);
+    std::vector<std::uint64_t> parents(workers * 64);
+    std::vector<std::uint64_t> children(workers * 64 * maxMoves);
+    std::vector<Position *> scratch(2 * workers);
+    for (Position *&pos : scratch) {
+        pos = this->puzzle->getInitialPosition();
+    }
+    std::vector<std::vector<std::uint64_t> > claimed(workers);
+    std::vector<std::uint64_t> frontier;
+
+    setDistance(scratch[0]->hash(), 0);
+    if (this->encoding == MOD3) {
+        frontier.push_back(scratch[0]->hash());
+    }
+    std::atomic<bool> found(true);
+    for (this->rmt = 0; ; ++this->rmt) {
+        int nextRmt = this->rmt + 1;
+        bool listed = this->encoding == MOD3 || unsigned(this->rmt) >= overflowCode;
+        bool overflows = this->encoding != MOD3 && unsigned(nextRmt) >= overflowCode;
+        bool collects = this->encoding == MOD3 || overflows;
+        unsigned currCode = this->encoding == MOD3 ? this->rmt % 3 : this->rmt;
+        unsigned nextCode = this->encoding == MOD3 ? nextRmt % 3 : overflows ? overflowCode : nextRmt;
+        found = false;
+        auto expand = [&](const std::uint64_t *hashes, std::size_t count, std::size_t worker) {
+            Position *currPos = scratch[2 * worker];
+            Position *nextPos = scratch[2 * worker + 1];
+            MoveCode *workerMoves = moves.data() + worker * maxMoves;
+            std::uint64_t *workerChildren = children.data() + worker * 64 * maxMoves;
+            bool workerFound = false;
+            auto visit = [&](std::size_t hash) {
+                if (claimCode(hash, unreachedCode(), nextCode)) {
+                    if (collects) {
+                        claimed[worker].push_back(hash);
+                    }
+                    workerFound = true;
+                }
+            };
+            if (this->puzzle->expandHashes(hashes, count, workerChildren)) {
+                for (std::size_t i = 0; i < count * maxMoves; ++i) {
+                    visit(workerChildren[i]);
                 }
-                /* Expand current possition and enqueue all children positions. */
-                MoveVector moves = puzzle->getMoves(currPos);
-                numPosNextLevel += moves.size();
-                for (Move *move : moves) {
-                    Position *nextPos = puzzle->doMove(currPos, move);
-                    fringe.push(nextPos);
-                    delete move;
+            } else {
+                for (std::size_t p = 0; p < count; ++p) {
+                    this->puzzle->unhash(hashes[p], currPos);
+                    std::size_t numMoves = this->puzzle->getMoveCodes(currPos, workerMoves);
+                    for (std::size_t i = 0; i < numMoves; ++i) {
+                        this->puzzle->doMove(currPos, workerMoves[i], nextPos);
+                        visit(nextPos->hash());
+                    }
                 }
             }
-            delete currPos;
-            if (--remPosInQueue == 0) {
-                remPosInQueue = numPosNextLevel;
-                numPosNextLevel = 0;
-                ++rmt;
+            if (workerFound) {
+                found = true;
+            }
+        };
+        if (listed) {
+            parallelFor(frontier.size(), 64, [&](std::size_t begin, std::size_t end, std::size_t worker) {
+                for (std::size_t i = begin; i < end; i += 64) {
+                    expand(frontier.data() + i, std::min<std::size_t>(64, end - i), worker);
+                }
+            });
+        } else {
+            std::uint64_t pattern = currCode * fieldMask;
+            parallelFor(numWords, TABLE_GRAIN, [&](std::size_t begin, std::size_t end, std::size_t worker) {
+                std::uint64_t *workerParents = parents.data() + worker * 64;
+                for (std::size_t w = begin; w < end; ++w) {
+                    std::size_t numParents = 0;
+                    std::uint64_t match = matchFields(loadWord(this->data.data() + w), pattern, this->encoding);
+                    for (; match; match &= match - 1) {
+                        workerParents[numParents++] = w * slotsPerWord + lowestBit(match) / this->encoding;
+                    }
+                    if (numParents) {
+                        expand(workerParents, numParents, worker);
+                    }
+                }
+            });
+        }
+        if (!found) {
+            break;
+        }
+        if (collects) {
+            frontier.clear();
+            for (std::vector<std::uint64_t> &hashes : claimed) {
+                for (std::uint64_t hash : hashes) {
+                    if (overflows) {
+                        this->overflow.insert(hash, nextRmt);
+                    }
+                    frontier.push_back(hash);
+                }
+                hashes.clear();
             }
         }
-        this->solved = true;
     }
-    return this->rmt;
+    for (Position *pos : scratch) {
+        delete pos;
+    }
 }
 
-void OptSolver::saveData(const std::string &filename) const {
+void OptSolver::searchBackward() {
+    /* Retrograde BFS over the positions that searchForward() reached.
+     * Their codes are first replaced with a pending code, the code that
+     * marks overflow entries, and the overflow table is cleared. The
+     * pending slots are then listed in table order, which numbers the
+     * reached positions densely, and searchBackwardWith() solves them
+     * with indices as narrow as their number allows. */
+    std::size_t numWords = this->data.size();
+    std::size_t slotsPerWord = 64 / this->encoding;
+    std::uint64_t fieldMask = ~std::uint64_t(0) / unreachedCode();
+    std::uint64_t pendingPattern = (unreachedCode() - 1) * fieldMask;
+    this->overflow.clear();
+    parallelFor(numWords, TABLE_GRAIN, [&](std::size_t begin, std::size_t end, std::size_t) {
+        for (std::size_t w = begin; w < end; ++w) {
+            /* Codes repeat in every byte, so the byte order of the words
+             * does not matter here. */
+            this->data[w] = pendingPattern | matchFields(this->data[w], ~std::uint64_t(0), this->encoding);
+        }
+    });
+    std::vector<std::uint64_t> hashes;
+    for (std::size_t w = 0; w < numWords; ++w) {
+        std::uint64_t match = matchFields(loadWord(this->data.data() + w), pendingPattern, this->encoding);
+        for (; match; match &= match - 1) {
+            hashes.push_back(w * slotsPerWord + lowestBit(match) / this->encoding);
+        }
+    }
+
+    if (hashes.size() <= UINT32_MAX) {
+        searchBackwardWith<std::uint32_t>(hashes);
+    } else {
+        searchBackwardWith<std::uint64_t>(hashes);
+    }
+    Position *initPos = this->puzzle->getInitialPosition();
+    this->rmt = getDistance(initPos->hash());
+    delete initPos;
+}
+
+/**
+ * @brief Solves the pending slots HASHES, sorted by hash, numbering them
+ * with INDEX.
+ */
+template <class Index>
+void OptSolver::searchBackwardWith(const std::vector<std::uint64_t> &hashes) {
+    /* Every reached position that is not primitive is expanded once,
+     * and each of its moves recorded as a backward edge from the child
+     * to it. Children were all reached by searchForward(), so their
+     * numbers are found by a binary search in HASHES. The BFS then runs
+     * level by level on the backward graph from all primitive positions
+     * at once: the parents of the positions decided at level RMT - 1
+     * that are still pending are decided at level RMT. A bitmap over the
+     * numbers says which positions are decided, so that a parent shared
+     * by several children is claimed once; codes are still written with
+     * a compare-and-swap, as neighbouring slots share bytes. Distances
+     * from the overflow code on go to the overflow table once their
+     * level is done. Slots still pending at the end cannot reach a
+     * primitive position and are marked unreached. */
+    std::size_t numStates = hashes.size();
+    unsigned pendingCode = unreachedCode() - 1;
+    std::size_t workers = numWorkers();
+    std::size_t maxMoves = this->puzzle->maxMoves();
+    std::vector<MoveCode> moves(workers * maxMoves);
+    std::vector<Position *> scratch(2 * workers);
+    for (Position *&pos : scratch) {
+        pos = this->puzzle->getInitialPosition();
+    }
+    std::vector<std::vector<Index> > edges(workers);
+    std::vector<std::vector<Index> > primitives(workers);
+    parallelFor(numStates, STATE_GRAIN, [&](std::size_t begin, std::size_t end, std::size_t worker) {
+        Position *currPos = scratch[2 * worker];
+        Position *nextPos = scratch[2 * worker + 1];
+        MoveCode *workerMoves = moves.data() + worker * maxMoves;
+        for (std::size_t i = begin; i < end; ++i) {
+            this->puzzle->unhash(hashes[i], currPos);
+            if (this->puzzle->isPrimitivePosition(currPos)) {
+                primitives[worker].push_back(static_cast<Index>(i));
+                continue;
+            }
+            std::size_t numMoves = this->puzzle->getMoveCodes(currPos, workerMoves);
+            for (std::size_t k = 0; k < numMoves; ++k) {
+                this->puzzle->doMove(currPos, workerMoves[k], nextPos);
+                std::vector<std::uint64_t>::const_iterator child =
+                        std::lower_bound(hashes.begin(), hashes.end(), nextPos->hash());
+                assert(child != hashes.end() && *child == nextPos->hash());
+                edges[worker].push_back(static_cast<Index>(child - hashes.begin()));
+                edges[worker].push_back(static_cast<Index>(i));
+            }
+        }
+    });
+    for (Position *pos : scratch) {
+        delete pos;
+    }
+    CsrGraph<Index> backwardGraph;
+    backwardGraph.reset(numStates);
+    for (const std::vector<Index> &pairs : edges) {
+        for (std::size_t e = 0; e < pairs.size(); e += 2) {
+            backwardGraph.countEdge(pairs[e]);
+        }
+    }
+    backwardGraph.allocate();
+    for (std::vector<Index> &pairs : edges) {
+        for (std::size_t e = 0; e < pairs.size(); e += 2) {
+            backwardGraph.addEdge(pairs[e], pairs[e + 1]);
+        }
+        std::vector<Index>().swap(pairs);
+    }
+    backwardGraph.finish();
+
+    std::unique_ptr<std::atomic<std::uint64_t>[]> decided(new std::atomic<std::uint64_t>[(numStates + 63) / 64]);
+    for (std::size_t w = 0; w < (numStates + 63) / 64; ++w) {
+        decided[w].store(0, std::memory_order_relaxed);
+    }
+    /* Decides position I at distance RMT unless it is already decided,
+     * and returns whether it was. */
+    auto decide = [&](Index i, int rmt) {
+        std::uint64_t bit = std::uint64_t(1) << (i % 64);
+        if (decided[i / 64].fetch_or(bit, std::memory_order_relaxed) & bit) {
+            return false;
+        }
+        claimCode(hashes[i], pendingCode, std::min(unsigned(rmt), pendingCode));
+        return true;
+    };
+    std::vector<Index> frontier;
+    for (std::vector<Index> &list : primitives) {
+        for (Index i : list) {
+            decide(i, 0);
+            frontier.push_back(i);
+        }
+        std::vector<Index>().swap(list);
+    }
+    std::vector<std::vector<Index> > next(workers);
+    for (int rmt = 1; !frontier.empty(); ++rmt) {
+        parallelFor(frontier.size(), STATE_GRAIN, [&](std::size_t begin, std::size_t end, std::size_t worker) {
+            for (std::size_t f = begin; f < end; ++f) {
+                for (const Index *parent = backwardGraph.begin(frontier[f]);
+                     parent != backwardGraph.end(frontier[f]); ++parent) {
+                    if (decide(*parent, rmt)) {
+                        next[worker].push_back(*parent);
+                    }
+                }
+            }
+        });
+        frontier.clear();
+        for (std::vector<Index> &list : next) {
+            for (Index i : list) {
+                if (unsigned(rmt) >= pendingCode) {
+                    this->overflow.insert(hashes[i], rmt);
+                }
+                frontier.push_back(i);
+            }
+            list.clear();
+        }
+    }
+    backwardGraph.clear();
+
+    parallelFor(numStates, STATE_GRAIN, [&](std::size_t begin, std::size_t end, std::size_t) {
+        for (std::size_t i = begin; i < end; ++i) {
+            if (!(decided[i / 64].load(std::memory_order_relaxed) >> (i % 64) & 1)) {
+                claimCode(hashes[i], pendingCode, unreachedCode());
+            }
+        }
+    });
+}
+
+/**
+ * @brief Writes the solved table to database FILENAME. Returns false if
+ * the table is not solved, the puzzle has no id or the file cannot be
+ * written.
+ */
+bool OptSolver::saveData(const std::string &filename) const {
+    std::string id = this->puzzle->getId();
+    if (!this->valid || !this->solved || id.empty() || id.size() >= sizeof(DbHeader::puzzleId)) {
+        return false;
+    }
+    DbHeader header = DbHeader();
+    std::memcpy(header.magic, DB_MAGIC, sizeof(header.magic));
+    header.version = DB_VERSION;
+    header.byteOrder = DB_BYTE_ORDER;
+    header.encoding = this->encoding;
+    header.rmt = this->rmt;
+    header.hashSize = this->puzzle->hashSize();
+    header.dataOffset = DB_DATA_OFFSET;
+    header.dataSize = tableSize(header.hashSize, this->encoding);
+    header.overflowCount = this->overflow.size();
+    std::memcpy(header.puzzleId, id.c_str(), id.size());
+
     std::ofstream of;
     of.open(filename, std::fstream::out | std::fstream::binary);
-    of.write(this->data, this->puzzle->hashSize());
+    of.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    std::vector<char> padding(DB_DATA_OFFSET - sizeof(header), 0);
+    of.write(padding.data(), padding.size());
+    of.write(reinterpret_cast<const char *>(this->table), header.dataSize);
+    this->overflow.forEach([&](std::uint64_t hash, int rmt) {
+        DbOverflowEntry entry = {hash, rmt, 0};
+        of.write(reinterpret_cast<const char *>(&entry), sizeof(entry));
+    });
     of.close();
+    return !of.fail();
+}
+
+/**
+ * @brief Maps database FILENAME in place of the table of this solver.
+ * Returns false and leaves the solver unchanged if the file is not a
+ * database of the same puzzle.
+ */
+bool OptSolver::loadData(const std::string &filename) {
+    std::shared_ptr<MappedFile> file(new MappedFile);
+    if (!this->valid || !file->open(filename) || file->size() < sizeof(DbHeader)) {
+        return false;
+    }
+    DbHeader header;
+    std::memcpy(&header, file->data(), sizeof(header));
+    std::string id = this->puzzle->getId();
+    if (std::memcmp(header.magic, DB_MAGIC, sizeof(header.magic)) != 0 ||
+            header.version != DB_VERSION || header.byteOrder != DB_BYTE_ORDER ||
+            (header.encoding != MOD3 && header.encoding != PACKED4 && header.encoding != PACKED8) ||
+            (header.encoding == MOD3 && !this->puzzle->isReversible()) ||
+            header.hashSize != this->puzzle->hashSize() ||
+            header.puzzleId[sizeof(header.puzzleId) - 1] != '\0' || id != header.puzzleId) {
+        return false;
+    }
+    Encoding encoding = static_cast<Encoding>(header.encoding);
+    if (header.dataSize != tableSize(header.hashSize, encoding) || header.dataOffset > file->size() ||
+            file->size() - header.dataOffset < header.dataSize ||
+            (file->size() - header.dataOffset - header.dataSize) / sizeof(DbOverflowEntry) < header.overflowCount) {
+        return false;
+    }
+
+    /* Overflow entries are few, so they are copied into memory. */
+    const char *entries = file->data() + header.dataOffset + header.dataSize;
+    this->overflow.clear();
+    for (std::uint64_t i = 0; i < header.overflowCount; ++i) {
+        DbOverflowEntry entry;
+        std::memcpy(&entry, entries + i * sizeof(entry), sizeof(entry));
+        this->overflow.insert(entry.hash, entry.rmt);
+    }
+    std::vector<std::uint64_t>().swap(this->data);
+    this->table = reinterpret_cast<const std::uint8_t *>(file->data() + header.dataOffset);
+    this->mapping = file;
+    this->encoding = encoding;
+    this->rmt = header.rmt;
+    this->solved = true;
+    return true;
 }
 
 void OptSolver::printShortestPathFrom(const Position *pos, std::ostream &outs) {
     this->solve();
-    int rmt = this->data[pos->hash()];
+    int rmt = this->valid ? distanceFrom(pos) : -1;
     if (rmt == -1) {
         outs << "[NO SOLUTION]" << std::endl;
         return;
     }
     Position *currPos = pos->getCopy();
-    Position *nextPos;
+    Position *nextPos = pos->getCopy();
+    std::vector<MoveCode> validMoves(this->puzzle->maxMoves());
     while (rmt) {
-        MoveVector validMoves = this->puzzle->getMoves(currPos);
-        for (Move *move : validMoves) {
-            nextPos = this->puzzle->doMove(currPos, move);
+        std::size_t numMoves = this->puzzle->getMoveCodes(currPos, validMoves.data());
+        for (std::size_t i = 0; i < numMoves; ++i) {
+            this->puzzle->doMove(currPos, validMoves[i], nextPos);
             std::size_t hash = nextPos->hash();
-            assert(this->data[hash] != -1);
-            int nextRmt = this->data[hash];
-            if (nextRmt < rmt) {
-                outs << "[rmt " << rmt << ": " << move->toString() << "]->";
-                delete currPos;
-                currPos = nextPos;
+            assert(!this->puzzle->isReversible() || getCode(hash) != unreachedCode());
+            bool closer = this->encoding == MOD3 ? getCode(hash) == unsigned(rmt - 1) % 3 :
+                                                   getDistance(hash) == rmt - 1;
+            if (closer) {
+                outs << "[rmt " << rmt << ": " << this->puzzle->moveString(validMoves[i]) << "]->";
+                std::swap(currPos, nextPos);
                 break;
-            } else {
-                delete nextPos;
             }
         }
         /* We should have found next move, otherwise there is a bug. */
-        for (Move *move : validMoves) {
-            delete move;
-        }
         --rmt;
     }
     delete currPos;
+    delete nextPos;
     outs << "[END]" << std::endl;
 }
+
+unsigned OptSolver::unreachedCode() const {
+    return (1u << this->encoding) - 1;
+}
+
+inline unsigned OptSolver::getCode(std::size_t hash) const {
+    std::size_t bit = hash * this->encoding;
+    /* Atomic, as solve() reads codes that other workers may be writing. */
+    return (__atomic_load_n(this->table + (bit >> 3), __ATOMIC_RELAXED) >> (bit & 7)) & unreachedCode();
+}
+
+inline void OptSolver::setCode(std::size_t hash, unsigned code) {
+    std::size_t bit = hash * this->encoding;
+    std::uint8_t &byte = reinterpret_cast<std::uint8_t *>(this->data.data())[bit >> 3];
+    byte = static_cast<std::uint8_t>((byte & ~(unreachedCode() << (bit & 7))) | (code << (bit & 7)));
+}
+
+/**
+ * @brief Sets the code of HASH to CODE and returns true if it is FROM,
+ * atomically with respect to other workers writing slots of the same
+ * byte. Returns false otherwise.
+ */
+inline bool OptSolver::claimCode(std::size_t hash, unsigned from, unsigned code) {
+    std::size_t bit = hash * this->encoding;
+    std::uint8_t *byte = reinterpret_cast<std::uint8_t *>(this->data.data()) + (bit >> 3);
+    std::uint8_t mask = static_cast<std::uint8_t>(unreachedCode() << (bit & 7));
+    std::uint8_t old = __atomic_load_n(byte, __ATOMIC_RELAXED);
+    std::uint8_t desired;
+    do {
+        if ((old & mask) != (from << (bit & 7))) {
+            return false;
+        }
+        desired = static_cast<std::uint8_t>((old & ~mask) | (code << (bit & 7)));
+    } while (!__atomic_compare_exchange_n(byte, &old, desired, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    return true;
+}
+
+void OptSolver::setDistance(std::size_t hash, int rmt) {
+    if (this->encoding == MOD3) {
+        setCode(hash, rmt % 3);
+    } else if (unsigned(rmt) < unreachedCode() - 1) {
+        setCode(hash, rmt);
+    } else {
+        /* The code just below the unreached code marks an overflow. */
+        setCode(hash, unreachedCode() - 1);
+        this->overflow.insert(hash, rmt);
+    }
+}
+
+/**
+ * @brief Returns the distance stored for HASH in a PACKED encoding, or -1
+ * if the position was not reached.
+ */
+int OptSolver::getDistance(std::size_t hash) const {
+    unsigned code = getCode(hash);
+    if (code == unreachedCode()) {
+        return -1;
+    } else if (code == unreachedCode() - 1) {
+        return *this->overflow.find(hash);
+    }
+    return code;
+}
+
+/**
+ * @brief Returns the distance of POS from the initial position, or -1 if
+ * POS was not reached.
+ */
+int OptSolver::distanceFrom(const Position *pos) const {
+    if (this->encoding != MOD3) {
+        return getDistance(pos->hash());
+    } else if (getCode(pos->hash()) == unreachedCode()) {
+        return -1;
+    }
+    /* Count the steps back to the initial position, following neighbours
+     * whose distance is one less. */
+    Position *initPos = this->puzzle->getInitialPosition();
+    Position *currPos = pos->getCopy();
+    Position *nextPos = pos->getCopy();
+    std::vector<MoveCode> moves(this->puzzle->maxMoves());
+    int rmt = 0;
+    while (rmt != -1 && !(*currPos == *initPos)) {
+        unsigned closerCode = (getCode(currPos->hash()) + 2) % 3;
+        std::size_t numMoves = this->puzzle->getMoveCodes(currPos, moves.data());
+        std::size_t i = 0;
+        for (; i < numMoves; ++i) {
+            this->puzzle->doMove(currPos, moves[i], nextPos);
+            if (getCode(nextPos->hash()) == closerCode) {
+                std::swap(currPos, nextPos);
+                ++rmt;
+                break;
+            }
+        }
+        if (i == numMoves) {
+            /* Not a reversible puzzle. */
+            rmt = -1;
+        }
+    }
+    delete initPos;
+    delete currPos;
+    delete nextPos;
+    return rmt;
+}
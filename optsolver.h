@@ -1,23 +1,86 @@
 #ifndef OPTSOLVER_H
 #define OPTSOLVER_H
+#include "mappedfile.h"
 #include "puzzle.h"
+#include "statemap.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
 
+/**
+ * @brief Solver for puzzles with a perfect hash of known size.
+ *
+ * OptSolver stores a distance for every position in a flat array indexed
+ * by the position's hash. In a reversible puzzle (see
+ * Puzzle::isReversible()), it is the distance from the initial position,
+ * found by a BFS from there. In any other puzzle, it is the remoteness of
+ * the positions reachable from the initial position, found by a
+ * retrograde search from their primitive positions. Distances are packed
+ * into 2, 4 or 8 bits per hash slot depending on the chosen encoding:
+ *
+ * MOD3: 2 bits holding the distance modulo 3. Distances of neighbouring
+ *     positions differ by at most one in reversible puzzles, so the
+ *     neighbour that is one step closer can still be told apart. The
+ *     absolute distance of a position is recovered by walking back to
+ *     the initial position. Only reversible puzzles can use MOD3.
+ * PACKED4, PACKED8: 4 or 8 bits holding the distance. Distances that do
+ *     not fit are stored in an overflow table on the side.
+ *
+ * In every encoding, the all-ones code marks a slot that was not reached,
+ * or a position that cannot reach a primitive position.
+ *
+ * PACKED solving keeps its frontiers in the packed table itself, so its
+ * peak memory is the table, the overflow table and a few scratch buffers
+ * per worker. MOD3 codes repeat every third distance, so MOD3 solving
+ * also lists the hashes of the current and next frontiers, which is
+ * still far less than the table for puzzles of many levels. The
+ * retrograde search additionally lists the hashes of the reached
+ * positions and builds their backward graph, so that each level only
+ * visits the parents of the level before.
+ *
+ * A solved table can be saved to a database file and loaded back by a
+ * later process. Loading maps the file read-only instead of reading it,
+ * so queries can be answered immediately and processes that load the
+ * same database share its pages.
+ */
 class OptSolver {
+public:
+    enum Encoding {MOD3 = 2, PACKED4 = 4, PACKED8 = 8};
+
 private:
     bool valid;
     bool solved;
     Puzzle *puzzle;
-    char *data;
+    Encoding encoding;
+    /* Packed codes, either owned in DATA or mapped from a database. */
+    std::vector<std::uint64_t> data;
+    std::shared_ptr<const MappedFile> mapping;
+    const std::uint8_t *table;
+    StateMap<int> overflow;
     int rmt;
 
 public:
-    OptSolver(const Puzzle *puzzle = nullptr);
+    OptSolver(const Puzzle *puzzle = nullptr, Encoding encoding = PACKED8);
     OptSolver(const OptSolver &other);
     ~OptSolver();
 
     int solve();
-    void saveData(const std::string &filename) const;
+    bool saveData(const std::string &filename) const;
+    bool loadData(const std::string &filename);
     void printShortestPathFrom(const Position *pos, std::ostream &outs);
+
+private:
+    void searchForward();
+    void searchBackward();
+    template <class Index>
+    void searchBackwardWith(const std::vector<std::uint64_t> &hashes);
+    unsigned unreachedCode() const;
+    unsigned getCode(std::size_t hash) const;
+    void setCode(std::size_t hash, unsigned code);
+    bool claimCode(std::size_t hash, unsigned from, unsigned code);
+    void setDistance(std::size_t hash, int rmt);
+    int getDistance(std::size_t hash) const;
+    int distanceFrom(const Position *pos) const;
 };
 
 #endif // OPTSOLVER_H
@@ -0,0 +1,204 @@
+#include "parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+typedef std::function<void(std::size_t, std::size_t, std::size_t)> RangeFn;
+
+/* Set on threads that are running a chunk, so that nested calls run on
+ * the calling thread instead of waiting for the pool they are part of. */
+thread_local bool inParallelFor = false;
+
+/**
+ * @brief Pool of numWorkers() - 1 threads that live as long as the
+ * process and run one parallelFor() at a time next to its caller.
+ *
+ * The chunks of a call are split evenly into one span per worker. A
+ * worker takes chunks from the front of its own span, and once that is
+ * empty, steals the back half of the span of another worker. A span is
+ * packed into one word, front in the upper half and back in the lower
+ * half, so that taking and stealing are single compare-and-swaps.
+ */
+class ThreadPool {
+private:
+    std::vector<std::thread> threads;
+    /* Held by the thread whose call is using the pool. */
+    std::mutex busy;
+
+    /* Protect the fields below. */
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::size_t generation;
+    std::size_t running;
+    bool stopping;
+
+    const RangeFn *fn;
+    std::size_t n;
+    std::size_t grain;
+    std::size_t workers;
+    std::unique_ptr<std::atomic<std::uint64_t>[]> spans;
+
+public:
+    ThreadPool() : generation(0), running(0), stopping(false), fn(nullptr), n(0), grain(1), workers(0),
+            spans(new std::atomic<std::uint64_t>[numWorkers()]) {
+        for (std::size_t i = 1; i < numWorkers(); ++i) {
+            this->threads.emplace_back(&ThreadPool::loop, this, i);
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->stopping = true;
+        }
+        this->wake.notify_all();
+        for (std::thread &t : this->threads) {
+            t.join();
+        }
+    }
+
+    /* Runs FN over NUMCHUNKS chunks with WORKERS workers, or returns false
+     * at once if another thread is using the pool. */
+    bool run(std::size_t n, std::size_t grain, std::size_t numChunks, std::size_t workers, const RangeFn &fn) {
+        std::unique_lock<std::mutex> busyLock(this->busy, std::try_to_lock);
+        if (!busyLock.owns_lock()) {
+            return false;
+        }
+        for (std::size_t i = 0; i < workers; ++i) {
+            std::uint64_t front = numChunks * i / workers;
+            std::uint64_t back = numChunks * (i + 1) / workers;
+            this->spans[i].store(front << 32 | back, std::memory_order_relaxed);
+        }
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->fn = &fn;
+            this->n = n;
+            this->grain = grain;
+            this->workers = workers;
+            this->running = workers - 1;
+            ++this->generation;
+        }
+        this->wake.notify_all();
+        /* The calling thread acts as worker 0. */
+        work(0);
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->done.wait(lock, [this] { return this->running == 0; });
+        return true;
+    }
+
+private:
+    void loop(std::size_t worker) {
+        std::size_t seen = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(this->mutex);
+                this->wake.wait(lock, [&] { return this->stopping || this->generation != seen; });
+                if (this->stopping) {
+                    return;
+                }
+                seen = this->generation;
+                if (worker >= this->workers) {
+                    /* Not needed for this call. */
+                    continue;
+                }
+            }
+            work(worker);
+            std::lock_guard<std::mutex> lock(this->mutex);
+            if (--this->running == 0) {
+                this->done.notify_one();
+            }
+        }
+    }
+
+    void work(std::size_t worker) {
+        inParallelFor = true;
+        std::uint64_t chunk;
+        while (takeFront(worker, chunk) || steal(worker, chunk)) {
+            std::size_t begin = chunk * this->grain;
+            (*this->fn)(begin, std::min<std::size_t>(begin + this->grain, this->n), worker);
+        }
+        inParallelFor = false;
+    }
+
+    bool takeFront(std::size_t worker, std::uint64_t &chunk) {
+        std::atomic<std::uint64_t> &span = this->spans[worker];
+        std::uint64_t value = span.load(std::memory_order_relaxed);
+        do {
+            chunk = value >> 32;
+            if (chunk >= (value & UINT32_MAX)) {
+                return false;
+            }
+        } while (!span.compare_exchange_weak(value, value + (std::uint64_t(1) << 32), std::memory_order_relaxed));
+        return true;
+    }
+
+    /* Moves the back half of the span of another worker to the empty span
+     * of WORKER, except for its first chunk, which goes to CHUNK. */
+    bool steal(std::size_t worker, std::uint64_t &chunk) {
+        for (std::size_t k = 1; k < this->workers; ++k) {
+            std::atomic<std::uint64_t> &victim = this->spans[(worker + k) % this->workers];
+            std::uint64_t value = victim.load(std::memory_order_relaxed);
+            std::uint64_t front, back, taken;
+            do {
+                front = value >> 32;
+                back = value & UINT32_MAX;
+                if (front >= back) {
+                    break;
+                }
+                taken = (back - front + 1) / 2;
+            } while (!victim.compare_exchange_weak(value, front << 32 | (back - taken), std::memory_order_relaxed));
+            if (front < back) {
+                chunk = back - taken;
+                this->spans[worker].store((chunk + 1) << 32 | back, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+ThreadPool &threadPool() {
+    static ThreadPool pool;
+    return pool;
+}
+} // Anonymous Namespace
+
+std::size_t numWorkers() {
+    static const std::size_t n = std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+    return n;
+}
+
+void parallelFor(std::size_t n, std::size_t grain, const RangeFn &fn) {
+    parallelFor(n, grain, numWorkers(), fn);
+}
+
+void parallelFor(std::size_t n, std::size_t grain, std::size_t maxWorkers, const RangeFn &fn) {
+    if (grain == 0) {
+        grain = 1;
+    }
+    if (maxWorkers == 0 || maxWorkers > numWorkers()) {
+        maxWorkers = numWorkers();
+    }
+    /* Spans count chunks in 32 bits. */
+    grain = std::max<std::size_t>(grain, n / UINT32_MAX + 1);
+    std::size_t numChunks = (n + grain - 1) / grain;
+    std::size_t workers = std::min(maxWorkers, numChunks);
+    if (workers > 1 && !inParallelFor && threadPool().run(n, grain, numChunks, workers, fn)) {
+        return;
+    }
+    /* Small ranges, nested calls and calls made while another thread is
+     * using the pool run on the calling thread. */
+    if (n) {
+        bool nested = inParallelFor;
+        inParallelFor = true;
+        fn(0, n, 0);
+        inParallelFor = nested;
+    }
+}
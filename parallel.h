@@ -0,0 +1,35 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+#include <cstddef>
+#include <functional>
+
+/**
+ * @brief Returns the maximum number of worker threads the solvers
+ * may use, which is the number of hardware threads available.
+ */
+std::size_t numWorkers();
+
+/**
+ * @brief Runs FN over the range [0, N) on the calling thread and a
+ * persistent pool of numWorkers() - 1 threads.
+ *
+ * The range is cut into chunks of GRAIN items, which are split evenly
+ * between the workers. A worker that runs out of chunks steals half of
+ * the chunks left to another worker, until none are left. FN is called
+ * as FN(begin, end, worker), where WORKER is an index smaller than
+ * numWorkers() that is unique among the threads running concurrently.
+ * Small ranges, calls made from within FN and calls made while another
+ * thread is using the pool are run on the calling thread as worker 0.
+ */
+void parallelFor(std::size_t n, std::size_t grain,
+                 const std::function<void(std::size_t, std::size_t, std::size_t)> &fn);
+
+/**
+ * @brief Same as above, but with at most MAXWORKERS threads. A
+ * MAXWORKERS of 0 or above numWorkers() means numWorkers(), so WORKER
+ * stays smaller than numWorkers() either way.
+ */
+void parallelFor(std::size_t n, std::size_t grain, std::size_t maxWorkers,
+                 const std::function<void(std::size_t, std::size_t, std::size_t)> &fn);
+
+#endif // PARALLEL_H
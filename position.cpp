@@ -1,5 +1,14 @@
 #include "position.h"
+#include "slabpool.h"
 
 Position::Position() {}
 
 Position::~Position() {}
+
+void *Position::operator new(std::size_t size) {
+    return slabAllocate(size);
+}
+
+void Position::operator delete(void *ptr, std::size_t size) {
+    slabDeallocate(ptr, size);
+}
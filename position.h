@@ -7,6 +7,10 @@ public:
     Position();
     virtual ~Position() = 0;
 
+    /* Objects of all subclasses are allocated from the slab pool. */
+    static void *operator new(std::size_t size);
+    static void operator delete(void *ptr, std::size_t size);
+
     virtual std::size_t hash() const = 0;
     virtual bool operator==(const Position &other) const = 0;
 
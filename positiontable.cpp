@@ -0,0 +1,157 @@
+#include "positiontable.h"
+
+/* class PositionTable::PositionMap */
+
+PositionTable::PositionMap::PositionMap() {
+    this->count = 0;
+    rehash(16);
+}
+
+PositionTable::PositionMap::PositionMap(const PositionMap &other) {
+    this->count = 0;
+    *this = other;
+}
+
+PositionTable::PositionMap::~PositionMap() {
+    clear();
+}
+
+PositionTable::PositionMap &PositionTable::PositionMap::operator =(const PositionMap &other) {
+    if (this != &other) {
+        clear();
+        this->slots = other.slots;
+        this->count = other.count;
+        for (Slot &slot : this->slots) {
+            if (slot.pos) {
+                slot.pos = slot.pos->getCopy();
+            }
+        }
+    }
+    return *this;
+}
+
+std::size_t PositionTable::PositionMap::size() const {
+    return this->count;
+}
+
+void PositionTable::PositionMap::clear() {
+    for (Slot &slot : this->slots) {
+        delete slot.pos;
+        slot.pos = nullptr;
+    }
+    this->count = 0;
+}
+
+PositionTable::Value *PositionTable::PositionMap::find(const Position *pos, std::uint64_t hash) {
+    std::size_t mask = this->slots.size() - 1;
+    for (std::size_t i = mixHash(hash) & mask; this->slots[i].pos; i = (i + 1) & mask) {
+        if (this->slots[i].hash == hash && *this->slots[i].pos == *pos) {
+            return &this->slots[i].value;
+        }
+    }
+    return nullptr;
+}
+
+bool PositionTable::PositionMap::insert(Position *pos, std::uint64_t hash, Value value) {
+    /* Keep the load factor at or below 1/2. */
+    if (2 * (this->count + 1) > this->slots.size()) {
+        rehash(2 * this->slots.size());
+    }
+    std::size_t mask = this->slots.size() - 1;
+    std::size_t i = mixHash(hash) & mask;
+    for (; this->slots[i].pos; i = (i + 1) & mask) {
+        if (this->slots[i].hash == hash && *this->slots[i].pos == *pos) {
+            return false;
+        }
+    }
+    this->slots[i] = Slot{hash, pos, value};
+    ++this->count;
+    return true;
+}
+
+void PositionTable::PositionMap::rehash(std::size_t capacity) {
+    std::vector<Slot> old(capacity, Slot{0, nullptr, 0});
+    old.swap(this->slots);
+    std::size_t mask = capacity - 1;
+    for (const Slot &slot : old) {
+        if (slot.pos) {
+            std::size_t i = mixHash(slot.hash) & mask;
+            while (this->slots[i].pos) {
+                i = (i + 1) & mask;
+            }
+            this->slots[i] = slot;
+        }
+    }
+}
+
+/* class PositionTable */
+
+PositionTable::PositionTable(bool injective, std::size_t shardBits) {
+    this->shardBits = shardBits;
+    this->injective = injective;
+    if (injective) {
+        this->keyShards.resize(std::size_t(1) << shardBits);
+    } else {
+        this->positionShards.resize(std::size_t(1) << shardBits);
+    }
+}
+
+std::size_t PositionTable::numShards() const {
+    return std::size_t(1) << this->shardBits;
+}
+
+std::size_t PositionTable::numShardBits() const {
+    return this->shardBits;
+}
+
+std::size_t PositionTable::shardOf(const Position *pos) const {
+    if (this->shardBits == 0) {
+        return 0;
+    }
+    /* Use the top bits of the mixed hash so that the low bits the shard
+     * itself probes on stay independent of the shard index. */
+    return mixHash(pos->hash()) >> (64 - this->shardBits);
+}
+
+std::size_t PositionTable::size() const {
+    std::size_t size = 0;
+    for (const StateMap<Value> &shard : this->keyShards) {
+        size += shard.size();
+    }
+    for (const PositionMap &shard : this->positionShards) {
+        size += shard.size();
+    }
+    return size;
+}
+
+void PositionTable::clear() {
+    for (StateMap<Value> &shard : this->keyShards) {
+        shard.clear();
+    }
+    for (PositionMap &shard : this->positionShards) {
+        shard.clear();
+    }
+}
+
+bool PositionTable::ownsPositions() const {
+    return !this->injective;
+}
+
+PositionTable::Value *PositionTable::find(const Position *pos) {
+    std::size_t shard = shardOf(pos);
+    if (this->injective) {
+        return this->keyShards[shard].find(pos->hash());
+    }
+    return this->positionShards[shard].find(pos, pos->hash());
+}
+
+const PositionTable::Value *PositionTable::find(const Position *pos) const {
+    return const_cast<PositionTable *>(this)->find(pos);
+}
+
+bool PositionTable::insert(std::size_t shard, Position *pos, Value value) {
+    if (this->injective) {
+        return this->keyShards[shard].insert(pos->hash(), value).second;
+    }
+    return this->positionShards[shard].insert(pos, pos->hash(), value);
+}
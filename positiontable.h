@@ -0,0 +1,145 @@
+#ifndef POSITIONTABLE_H
+#define POSITIONTABLE_H
+#include "position.h"
+#include "statemap.h"
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Maps positions to 64-bit integer values.
+ *
+ * The table is split into a fixed number of shards chosen by the hash
+ * of the position. Shards are independent of each other, so different
+ * threads may insert into different shards at the same time. Lookups
+ * are safe from any thread as long as no thread is inserting.
+ *
+ * Every shard is an open-addressing hash table probed linearly on the
+ * mixed hash of the position. If the table is told that position hashes
+ * are injective, a position is stored as its raw 64-bit hash next to its
+ * value and the position itself is not kept. Otherwise the table keeps
+ * a pointer to the position together with its hash, owns these keys and
+ * deletes them when destroyed.
+ */
+class PositionTable {
+public:
+    typedef std::int64_t Value;
+    const static std::size_t DEFAULT_SHARD_BITS = 8;
+
+private:
+    /* Shard used when positions must be compared with operator==. */
+    class PositionMap {
+    private:
+        struct Slot {
+            std::uint64_t hash;
+            Position *pos;
+            Value value;
+        };
+
+        std::vector<Slot> slots;
+        std::size_t count;
+
+    public:
+        PositionMap();
+        PositionMap(const PositionMap &other);
+        ~PositionMap();
+        PositionMap &operator =(const PositionMap &other);
+
+        std::size_t size() const;
+        void clear();
+        Value *find(const Position *pos, std::uint64_t hash);
+        bool insert(Position *pos, std::uint64_t hash, Value value);
+
+        template <class Fn>
+        void forEach(Fn fn) const {
+            for (const Slot &slot : this->slots) {
+                if (slot.pos) {
+                    fn(slot.hash, slot.value);
+                }
+            }
+        }
+
+        template <class Fn>
+        void forEach(Fn fn) {
+            for (Slot &slot : this->slots) {
+                if (slot.pos) {
+                    fn(slot.hash, slot.value);
+                }
+            }
+        }
+
+    private:
+        void rehash(std::size_t capacity);
+    };
+
+    std::size_t shardBits;
+    bool injective;
+    std::vector<StateMap<Value> > keyShards;
+    std::vector<PositionMap> positionShards;
+
+public:
+    PositionTable(bool injective = false, std::size_t shardBits = DEFAULT_SHARD_BITS);
+
+    std::size_t numShards() const;
+    std::size_t numShardBits() const;
+    std::size_t shardOf(const Position *pos) const;
+    std::size_t size() const;
+    void clear();
+
+    /**
+     * @brief Returns true if the table keeps the positions inserted into
+     * it, false if it only keeps their hashes.
+     */
+    bool ownsPositions() const;
+
+    /**
+     * @brief Returns a pointer to the value stored for POS, or nullptr
+     * if POS is not in the table.
+     */
+    Value *find(const Position *pos);
+    const Value *find(const Position *pos) const;
+
+    /**
+     * @brief Inserts POS into shard SHARD, which must be shardOf(POS).
+     * Returns true if POS was not in the table, in which case the table
+     * takes ownership of POS if ownsPositions(). POS is left to the
+     * caller in all other cases.
+     */
+    bool insert(std::size_t shard, Position *pos, Value value);
+
+    /**
+     * @brief Calls FN(hash, value) for every entry in shard SHARD.
+     */
+    template <class Fn>
+    void forEachInShard(std::size_t shard, Fn fn) const {
+        if (this->injective) {
+            this->keyShards[shard].forEach(fn);
+        } else {
+            this->positionShards[shard].forEach(fn);
+        }
+    }
+
+    /**
+     * @brief Calls FN(hash, value) for every entry in shard SHARD, where
+     * VALUE is a reference through which the entry may be updated.
+     */
+    template <class Fn>
+    void forEachInShard(std::size_t shard, Fn fn) {
+        if (this->injective) {
+            this->keyShards[shard].forEach(fn);
+        } else {
+            this->positionShards[shard].forEach(fn);
+        }
+    }
+
+    /**
+     * @brief Calls FN(hash, value) for every entry in the table.
+     */
+    template <class Fn>
+    void forEach(Fn fn) const {
+        for (std::size_t i = 0; i < numShards(); ++i) {
+            forEachInShard(i, fn);
+        }
+    }
+};
+
+#endif // POSITIONTABLE_H
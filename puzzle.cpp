@@ -3,3 +3,33 @@
 Puzzle::Puzzle() {}
 
 Puzzle::~Puzzle() {}
+
+bool Puzzle::hasInjectiveHash() const {
+    return false;
+}
+
+bool Puzzle::isReversible() const {
+    return false;
+}
+
+void Puzzle::canonicalize(Position *pos) const {
+    (void)pos; // Unused.
+}
+
+bool Puzzle::unhash(std::size_t hash, Position *pos) const {
+    (void)hash; // Unused.
+    (void)pos; // Unused.
+    return false;
+}
+
+bool Puzzle::expandHashes(const std::uint64_t *hashes, std::size_t count,
+                          std::uint64_t *children) const {
+    (void)hashes; // Unused.
+    (void)count; // Unused.
+    (void)children; // Unused.
+    return false;
+}
+
+std::string Puzzle::getId() const {
+    return std::string();
+}
@@ -2,6 +2,7 @@
 #define PUZZLE_H
 #include "move.h"
 #include "position.h"
+#include <string>
 #include <vector>
 
 class Puzzle {
@@ -13,8 +14,85 @@ public:
     virtual bool isPrimitivePosition(const Position *pos) const = 0;
     virtual std::vector<Move *> getMoves(const Position *pos) const = 0;
     virtual Position *doMove(const Position *pos, const Move *move) const = 0;
+
+    /* Allocation-free move interface. A move is identified by a MoveCode
+     * whose meaning is private to the puzzle. */
+
+    /**
+     * @brief Returns the maximum number of valid moves at any position.
+     */
+    virtual std::size_t maxMoves() const = 0;
+
+    /**
+     * @brief Writes the codes of all valid moves at POS into MOVES, which
+     * must have room for maxMoves() codes, and returns how many it wrote.
+     * The moves are in the same order as getMoves(POS).
+     */
+    virtual std::size_t getMoveCodes(const Position *pos, MoveCode *moves) const = 0;
+
+    /**
+     * @brief Overwrites CHILD with the position reached by making valid
+     * move MOVE at POS. CHILD must be a position of this puzzle other
+     * than POS, such as one obtained from getInitialPosition().
+     */
+    virtual void doMove(const Position *pos, MoveCode move, Position *child) const = 0;
+
+    /**
+     * @brief Returns the same string as Move::toString() for MOVE.
+     */
+    virtual std::string moveString(MoveCode move) const = 0;
     virtual Puzzle *getCopy() const = 0;
     virtual std::size_t hashSize() const = 0;
+
+    /**
+     * @brief Returns true if two positions of this puzzle are equal
+     * exactly when their hashes are equal. Solvers may then identify a
+     * position by its hash alone. Returns false by default.
+     */
+    virtual bool hasInjectiveHash() const;
+
+    /**
+     * @brief Returns true if every move can be undone by a move, so that
+     * the distance of a position from the initial position is also the
+     * distance back to it. OptSolver solves such puzzles with a BFS from
+     * the initial position and all others with a retrograde search from
+     * their primitive positions. Returns false by default.
+     */
+    virtual bool isReversible() const;
+
+    /**
+     * @brief Overwrites POS with the canonical representative of the
+     * positions symmetric to it, all of which have the same remoteness.
+     * Solver stores canonical positions only. The default leaves POS
+     * unchanged.
+     */
+    virtual void canonicalize(Position *pos) const;
+
+    /**
+     * @brief Overwrites POS with the position whose hash is HASH and
+     * returns true. Returns false, which is the default, if positions
+     * cannot be rebuilt from their hashes. OptSolver requires this for
+     * puzzles with a nonzero hashSize().
+     */
+    virtual bool unhash(std::size_t hash, Position *pos) const;
+
+    /**
+     * @brief Batch expansion for puzzles in which every position has
+     * exactly maxMoves() moves. Writes the hashes of the children of the
+     * COUNT positions whose hashes are in HASHES into CHILDREN, maxMoves()
+     * per parent in the order of getMoveCodes(), and returns true.
+     * Returns false, which is the default, if the puzzle has no such
+     * kernel, in which case solvers expand positions one move at a time.
+     */
+    virtual bool expandHashes(const std::uint64_t *hashes, std::size_t count,
+                              std::uint64_t *children) const;
+
+    /**
+     * @brief Returns a string naming the puzzle and its parameters, such
+     * as "lightsout 6 6". Saved databases record it so that they are only
+     * loaded into a solver of the same puzzle. Empty by default.
+     */
+    virtual std::string getId() const;
 };
 
 #endif // PUZZLE_H
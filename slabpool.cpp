@@ -0,0 +1,315 @@
+#include "slabpool.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace {
+const std::size_t ALIGNMENT = 16;
+const std::size_t NUM_CLASSES = SLAB_MAX_OBJECT_SIZE / ALIGNMENT;
+/* Number of objects moved between a thread and the depot at a time. */
+const std::size_t BATCH_SIZE = 256;
+
+struct FreeNode {
+    FreeNode *next;
+};
+
+struct FreeList {
+    FreeNode *head;
+    std::size_t length;
+};
+
+/* A slab carved into objects of a single size class. */
+struct Slab {
+    char *base;
+    std::size_t sizeClass;
+    /* Number of its objects found free by slabTrim(). */
+    std::size_t numFree;
+
+    bool operator<(const Slab &other) const {
+        return this->base < other.base;
+    }
+};
+
+/* Free objects shared by all threads, kept as chains of at most
+ * BATCH_SIZE objects so that a chain can be handed over in O(1). */
+struct Depot {
+    std::mutex mutex;
+    std::vector<FreeList> batches[NUM_CLASSES];
+    std::vector<Slab> slabs;
+};
+
+/* Never destroyed, so that objects may still be freed while static
+ * objects are being destroyed. */
+Depot &depot() {
+    static Depot *depot = new Depot;
+    return *depot;
+}
+
+/* Counters of exited threads and of objects served without a cache. */
+std::atomic<std::size_t> sharedAllocations(0);
+std::atomic<std::size_t> sharedDeallocations(0);
+
+struct ThreadCache {
+    FreeList lists[NUM_CLASSES];
+    std::size_t allocations;
+    std::size_t deallocations;
+};
+
+/* Pointer to the cache of the calling thread. It stays null once the
+ * thread has started exiting, after which the depot is used directly. */
+thread_local ThreadCache *threadCache = nullptr;
+thread_local bool threadExiting = false;
+
+inline std::size_t classOf(std::size_t size) {
+    return size ? (size - 1) / ALIGNMENT : 0;
+}
+
+inline std::size_t classSize(std::size_t sizeClass) {
+    return (sizeClass + 1) * ALIGNMENT;
+}
+
+inline std::size_t objectsPerSlab(std::size_t sizeClass) {
+    return SLAB_SIZE / classSize(sizeClass);
+}
+
+/* Returns the slab holding NODE in SLABS, which are sorted by address. */
+Slab &slabOf(std::vector<Slab> &slabs, const FreeNode *node) {
+    Slab key = {reinterpret_cast<char *>(const_cast<FreeNode *>(node)), 0, 0};
+    return *(std::upper_bound(slabs.begin(), slabs.end(), key) - 1);
+}
+
+/* Hands LIST over to the depot in chains of at most BATCH_SIZE objects. */
+void releaseToDepot(std::size_t sizeClass, FreeList &list) {
+    Depot &d = depot();
+    std::lock_guard<std::mutex> lock(d.mutex);
+    while (list.head) {
+        FreeList batch = {list.head, 1};
+        FreeNode *tail = list.head;
+        while (batch.length < BATCH_SIZE && tail->next) {
+            tail = tail->next;
+            ++batch.length;
+        }
+        list.head = tail->next;
+        list.length -= batch.length;
+        tail->next = nullptr;
+        d.batches[sizeClass].push_back(batch);
+    }
+}
+
+/* Returns a chain of free objects of class SIZECLASS, taken from the
+ * depot or carved out of a new slab. */
+FreeList acquireFromDepot(std::size_t sizeClass) {
+    Depot &d = depot();
+    std::lock_guard<std::mutex> lock(d.mutex);
+    if (!d.batches[sizeClass].empty()) {
+        FreeList batch = d.batches[sizeClass].back();
+        d.batches[sizeClass].pop_back();
+        return batch;
+    }
+    char *slab = static_cast<char *>(::operator new(SLAB_SIZE));
+    Slab entry = {slab, sizeClass, 0};
+    d.slabs.push_back(entry);
+    std::size_t size = classSize(sizeClass);
+    FreeList list = {nullptr, 0};
+    for (std::size_t offset = 0; offset + size <= SLAB_SIZE; offset += size) {
+        FreeNode *node = reinterpret_cast<FreeNode *>(slab + offset);
+        node->next = list.head;
+        list.head = node;
+        ++list.length;
+    }
+    return list;
+}
+
+struct CacheOwner {
+    ThreadCache cache;
+
+    CacheOwner() : cache() {
+        threadCache = &this->cache;
+    }
+
+    ~CacheOwner() {
+        threadCache = nullptr;
+        threadExiting = true;
+        for (std::size_t i = 0; i < NUM_CLASSES; ++i) {
+            releaseToDepot(i, this->cache.lists[i]);
+        }
+        sharedAllocations += this->cache.allocations;
+        sharedDeallocations += this->cache.deallocations;
+    }
+};
+
+void *allocateUncached(std::size_t sizeClass) {
+    FreeList list = acquireFromDepot(sizeClass);
+    FreeNode *node = list.head;
+    list.head = node->next;
+    --list.length;
+    releaseToDepot(sizeClass, list);
+    return node;
+}
+
+void deallocateUncached(std::size_t sizeClass, void *ptr) {
+    FreeNode *node = static_cast<FreeNode *>(ptr);
+    node->next = nullptr;
+    FreeList list = {node, 1};
+    releaseToDepot(sizeClass, list);
+}
+
+ThreadCache *getThreadCache() {
+    if (!threadCache && !threadExiting) {
+        thread_local CacheOwner owner;
+    }
+    return threadCache;
+}
+}
+
+void *slabAllocate(std::size_t size) {
+    if (size > SLAB_MAX_OBJECT_SIZE) {
+        ++sharedAllocations;
+        return ::operator new(size);
+    }
+    std::size_t sizeClass = classOf(size);
+    ThreadCache *cache = getThreadCache();
+    if (!cache) {
+        ++sharedAllocations;
+        return allocateUncached(sizeClass);
+    }
+    FreeList &list = cache->lists[sizeClass];
+    if (!list.head) {
+        list = acquireFromDepot(sizeClass);
+    }
+    FreeNode *node = list.head;
+    list.head = node->next;
+    --list.length;
+    ++cache->allocations;
+    return node;
+}
+
+void slabDeallocate(void *ptr, std::size_t size) {
+    if (!ptr) {
+        return;
+    }
+    if (size > SLAB_MAX_OBJECT_SIZE) {
+        ++sharedDeallocations;
+        ::operator delete(ptr);
+        return;
+    }
+    std::size_t sizeClass = classOf(size);
+    ThreadCache *cache = getThreadCache();
+    if (!cache) {
+        ++sharedDeallocations;
+        deallocateUncached(sizeClass, ptr);
+        return;
+    }
+    FreeList &list = cache->lists[sizeClass];
+    FreeNode *node = static_cast<FreeNode *>(ptr);
+    node->next = list.head;
+    list.head = node;
+    ++list.length;
+    ++cache->deallocations;
+    /* Objects are often freed by a different thread than the one that
+     * allocated them, so hand surplus objects back to the depot. */
+    if (list.length >= 2 * BATCH_SIZE) {
+        FreeList surplus = {list.head, BATCH_SIZE};
+        FreeNode *tail = list.head;
+        for (std::size_t i = 1; i < BATCH_SIZE; ++i) {
+            tail = tail->next;
+        }
+        list.head = tail->next;
+        list.length -= BATCH_SIZE;
+        tail->next = nullptr;
+        Depot &d = depot();
+        std::lock_guard<std::mutex> lock(d.mutex);
+        d.batches[sizeClass].push_back(surplus);
+    }
+}
+
+SlabStats slabStats() {
+    SlabStats stats;
+    stats.allocations = sharedAllocations;
+    stats.deallocations = sharedDeallocations;
+    ThreadCache *cache = getThreadCache();
+    if (cache) {
+        stats.allocations += cache->allocations;
+        stats.deallocations += cache->deallocations;
+    }
+    Depot &d = depot();
+    std::lock_guard<std::mutex> lock(d.mutex);
+    stats.slabs = d.slabs.size();
+    return stats;
+}
+
+std::size_t slabTrim() {
+    ThreadCache *cache = getThreadCache();
+    if (cache) {
+        for (std::size_t i = 0; i < NUM_CLASSES; ++i) {
+            releaseToDepot(i, cache->lists[i]);
+        }
+    }
+    Depot &d = depot();
+    std::lock_guard<std::mutex> lock(d.mutex);
+    /* Count the free objects of each slab. A slab all of whose objects
+     * are in the depot is not in use by anyone. */
+    std::sort(d.slabs.begin(), d.slabs.end());
+    for (Slab &slab : d.slabs) {
+        slab.numFree = 0;
+    }
+    for (std::size_t i = 0; i < NUM_CLASSES; ++i) {
+        for (const FreeList &batch : d.batches[i]) {
+            for (FreeNode *node = batch.head; node; node = node->next) {
+                ++slabOf(d.slabs, node).numFree;
+            }
+        }
+    }
+    bool anyFree = false;
+    for (const Slab &slab : d.slabs) {
+        anyFree |= slab.numFree == objectsPerSlab(slab.sizeClass);
+    }
+    if (!anyFree) {
+        return 0;
+    }
+
+    /* Rebuild the batches from the objects of the slabs that are kept,
+     * then release the others. */
+    for (std::size_t i = 0; i < NUM_CLASSES; ++i) {
+        FreeList kept = {nullptr, 0};
+        for (const FreeList &batch : d.batches[i]) {
+            FreeNode *node = batch.head;
+            while (node) {
+                FreeNode *next = node->next;
+                const Slab &slab = slabOf(d.slabs, node);
+                if (slab.numFree != objectsPerSlab(slab.sizeClass)) {
+                    node->next = kept.head;
+                    kept.head = node;
+                    ++kept.length;
+                }
+                node = next;
+            }
+        }
+        d.batches[i].clear();
+        while (kept.head) {
+            FreeList batch = {kept.head, 1};
+            FreeNode *tail = kept.head;
+            while (batch.length < BATCH_SIZE && tail->next) {
+                tail = tail->next;
+                ++batch.length;
+            }
+            kept.head = tail->next;
+            tail->next = nullptr;
+            d.batches[i].push_back(batch);
+        }
+    }
+    std::size_t released = 0;
+    std::size_t numKept = 0;
+    for (const Slab &slab : d.slabs) {
+        if (slab.numFree == objectsPerSlab(slab.sizeClass)) {
+            ::operator delete(slab.base);
+            ++released;
+        } else {
+            d.slabs[numKept++] = slab;
+        }
+    }
+    d.slabs.resize(numKept);
+    return released;
+}
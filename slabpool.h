@@ -0,0 +1,43 @@
+#ifndef SLABPOOL_H
+#define SLABPOOL_H
+#include <cstddef>
+
+/**
+ * @brief Counters of the slab pool, summed over all threads that have
+ * exited and the calling thread.
+ */
+struct SlabStats {
+    /* Number of objects handed out and returned. */
+    std::size_t allocations;
+    std::size_t deallocations;
+    /* Number of slabs taken from the global heap and not released. */
+    std::size_t slabs;
+};
+
+/**
+ * @brief Allocates SIZE bytes from the slab pool.
+ *
+ * Sizes up to SLAB_MAX_OBJECT_SIZE are rounded up to a multiple of 16
+ * and served from per-thread free lists, which are refilled from slabs
+ * of SLAB_SIZE bytes. Larger sizes go to the global heap. Memory must
+ * be returned with slabDeallocate() and the same SIZE, possibly from a
+ * different thread. Freed objects are kept for reuse by the pool until
+ * slabTrim() returns their slabs to the global heap.
+ */
+void *slabAllocate(std::size_t size);
+void slabDeallocate(void *ptr, std::size_t size);
+
+/**
+ * @brief Returns the slabs none of whose objects are in use to the
+ * global heap, after handing the free objects of the calling thread back
+ * to the pool. Objects cached by other threads keep their slabs. Returns
+ * the number of slabs released.
+ */
+std::size_t slabTrim();
+
+SlabStats slabStats();
+
+const std::size_t SLAB_SIZE = 64 * 1024;
+const std::size_t SLAB_MAX_OBJECT_SIZE = 64;
+
+#endif // SLABPOOL_H
@@ -1,232 +1,347 @@
 #include "solver.h"
+#include "csrgraph.h"
+#include "parallel.h"
+#include "slabpool.h"
+#include <atomic>
 #include <bitset>
 #include <cassert>
-#include <queue>
-#include <thread>
-#include <unordered_set>
+#include <climits>
+#include <limits>
+#include <memory>
+#include <utility>
 #include <vector>
 #define RMT_MAX INT_MAX
 
-typedef std::unordered_map<Position *, std::vector<Position *>, PositionHasher, PositionEqualFn> PositionGraph;
-typedef std::unordered_set<Position *, PositionHasher, PositionEqualFn> PositionSet;
-typedef std::vector<Position *> PositionVector;
-typedef std::queue<Position *> PositionQueue;
-typedef std::vector<Move *> MoveVector;
-typedef std::unordered_map<Position *, int, PositionHasher, PositionEqualFn> SolverData;
-
-Solver::Solver(const Puzzle *puzzle) {
+Solver::Solver(const Puzzle *puzzle) : data(puzzle->hasInjectiveHash()) {
     this->solved = false;
     this->puzzle = puzzle->getCopy();
 }
 
-Solver::Solver(const Solver &other) {
+Solver::Solver(const Solver &other) : data(other.data) {
     this->solved = other.solved;
     this->puzzle = other.puzzle->getCopy();
-    if (other.solved) {
-        this->data = other.data;
-    }
 }
 
 Solver::~Solver() {
     delete this->puzzle;
-    for (auto it = this->data.begin(); it != this->data.end(); ++it) {
-        delete it->first;
-    }
+    /* Release the slabs of the positions kept as keys. */
+    this->data.clear();
+    slabTrim();
 }
 
 namespace {
-bool contains(const PositionSet &set, Position *pos) {
-    return set.find(pos) != set.end();
-}
+/* Number of frontier positions handed to a worker at a time. */
+const std::size_t DISCOVERY_GRAIN = 64;
+const std::size_t RETROGRADE_GRAIN = 1024;
+
+/* During discovery a position is referred to by (i << shardBits) | shard,
+ * where i counts the positions found so far in its shard. Each shard can
+ * hand out references on its own, and the references are turned into
+ * dense indices once the size of every shard is known. References are
+ * kept in the table as values and in the edge lists as INDEX, the type
+ * of the dense indices. */
+typedef PositionTable::Value PositionRef;
+
+/* An edge of the game graph found during discovery: move MOVE made at
+ * the frontier position with index PARENT. The child is recomputed from
+ * the two when the edge is merged, so no position is allocated for it. */
+struct Edge {
+    std::size_t parent;
+    MoveCode move;
+};
+typedef std::vector<Edge> EdgeVector;
+
+struct FrontierEntry {
+    const Position *pos;
+    PositionRef ref;
+};
+typedef std::vector<FrontierEntry> Frontier;
+
+/* Everything findPrimitives() learns about the game graph. */
+template <class Index>
+struct Discovery {
+    /* Number of positions in each shard. */
+    std::vector<std::size_t> shardSizes;
+    /* (child, parent) reference pairs of all edges, by shard of the child. */
+    std::vector<std::vector<Index> > edges;
+    /* References of all primitive positions, by shard. */
+    std::vector<std::vector<Index> > primitives;
+};
+
+/**
+ * @brief Maps position references to dense indices in [0, size()).
+ */
+class DenseIndex {
+private:
+    std::size_t shardBits;
+    PositionRef shardMask;
+    std::vector<std::size_t> bases;
+
+public:
+    DenseIndex(std::size_t shardBits, const std::vector<std::size_t> &shardSizes) {
+        this->shardBits = shardBits;
+        this->shardMask = (PositionRef(1) << shardBits) - 1;
+        this->bases.resize(shardSizes.size() + 1, 0);
+        for (std::size_t i = 0; i < shardSizes.size(); ++i) {
+            this->bases[i + 1] = this->bases[i] + shardSizes[i];
+        }
+    }
 
-void addParent(PositionGraph &graph, Position *child, Position *parent) {
-    Position *parentCpy = parent->getCopy();
-    auto it = graph.find(child);
-    if (it == graph.end()) {
-        graph.emplace(child->getCopy(), std::vector<Position *>(1, parentCpy));
-    } else {
-        it->second.push_back(parentCpy);
+    std::size_t size() const {
+        return this->bases.back();
     }
-}
 
-void findPrimitives(const Puzzle *puzzle, PositionVector &primitives,
-                    PositionGraph &backwardGraph, SolverData& data) {
-    /* Memory handling: If a position has been closed when it is visited, deallocate it immediately;
-     * otherwise, store the pointer in closed and deallocate when finished. */
-    Position *initial_position = puzzle->getInitialPosition();
-    PositionQueue fringe;
-    PositionSet closed;
-    fringe.push(initial_position);
-
-    /* Initialize the root node in the backward graph. We do this extra
-     * step because the root is not always reacheable from itself. */
-    backwardGraph.emplace(initial_position->getCopy(), PositionVector());
-
-    while (fringe.size()) {
-        Position *curr_pos = fringe.front();
-        fringe.pop();
-        if (contains(closed, curr_pos)) {
-            /* If current position is closed, deallocate it in memory and
-             * continue loop. */
-            delete curr_pos;
-            continue;
-        }
-        closed.insert(curr_pos);
-        data.emplace(curr_pos->getCopy(), RMT_MAX);
-        if (puzzle->isPrimitivePosition(curr_pos)) {
-            /* Current position is a primitive. Add it to the list of primitive positions. */
-            primitives.push_back(curr_pos->getCopy());
-        }
-        /* Expand current possition and enqueue all children positions. */
-        MoveVector moves = puzzle->getMoves(curr_pos);
-        for (Move *move : moves) {
-            Position *next_pos = puzzle->doMove(curr_pos, move);
-            fringe.push(next_pos);
-            addParent(backwardGraph, next_pos, curr_pos);
-            delete move;
-        }
+    std::size_t operator()(PositionRef ref) const {
+        return this->bases[ref & this->shardMask] + (ref >> this->shardBits);
     }
-    /* Deallocate all position pointers in closed set. */
-    for (Position *pos : closed) {
-        delete pos;
+};
+
+/* Deletes the positions of FRONTIER and empties it. */
+void deleteFrontier(Frontier &frontier) {
+    for (const FrontierEntry &entry : frontier) {
+        delete entry.pos;
     }
+    frontier.clear();
 }
 
-void updateRemoteness(SolverData &data, Position *pos, int rmt) {
-    assert(data.find(pos) != data.end());
-    data[pos] = std::min(data[pos], rmt);
-}
+/**
+ * @brief Finds all positions reachable from the initial position of
+ * PUZZLE. Returns false if there are too many positions for their
+ * references to fit in INDEX.
+ */
+template <class Index>
+bool findPrimitives(const Puzzle *puzzle, PositionTable &data, Discovery<Index> &discovery) {
+    /* Level-synchronous BFS from the initial position. Every level runs in
+     * two parallel phases:
+     * 1. The frontier is expanded by the worker pool. Each worker writes the
+     *    edges it finds into its own buffers, one buffer per shard of DATA.
+     * 2. Each shard is then processed by exactly one worker, which merges
+     *    the buffered edges of that shard into DATA and DISCOVERY and
+     *    collects the newly found positions into the next frontier.
+     * Children are generated into one scratch position per worker, so
+     * only positions seen for the first time are allocated. Frontier
+     * positions are owned by DATA if it keeps its keys, and are deleted
+     * once their level is merged otherwise. Every position is stored in
+     * DATA with its reference as value. Children are canonicalized
+     * before they are looked up, so only canonical positions are stored. */
+    std::size_t numShards = data.numShards();
+    std::size_t shardBits = data.numShardBits();
+    discovery.shardSizes.assign(numShards, 0);
+    discovery.edges.assign(numShards, std::vector<Index>());
+    discovery.primitives.assign(numShards, std::vector<Index>());
+    const PositionRef maxRef = std::numeric_limits<Index>::max();
+    std::atomic<bool> overflow(false);
+    std::vector<std::vector<EdgeVector> > edges(numWorkers(), std::vector<EdgeVector>(numShards));
+    std::vector<Frontier> discovered(numShards);
+    std::size_t maxMoves = puzzle->maxMoves();
+    std::vector<MoveCode> moves(numWorkers() * maxMoves);
+    std::vector<Position *> scratch(numWorkers());
+    for (Position *&child : scratch) {
+        child = puzzle->getInitialPosition();
+    }
 
-void updateRemotenessFrom(SolverData &data, PositionGraph& backwardGraph, Position *primitive) {
-    /* Similar logic as in findPrimitives(). */
-    PositionQueue fringe;
-    PositionSet closed;
-    fringe.push(primitive);
-    int rmt = 0;
-    std::size_t rem = 1;
-    std::size_t numPosNextLevel = 0;
-
-    while (fringe.size()) {
-        Position *curr_pos = fringe.front();
-        fringe.pop();
-        if (contains(closed, curr_pos)) {
-            delete curr_pos;
-        } else {
-            closed.insert(curr_pos);
-            /* Update remoteness of current position. */
-            updateRemoteness(data, curr_pos, rmt);
-            for (Position *next_pos : backwardGraph.at(curr_pos)) {
-                fringe.push(next_pos->getCopy());
-                ++numPosNextLevel;
+    Position *initialPosition = puzzle->getInitialPosition();
+    puzzle->canonicalize(initialPosition);
+    std::size_t initialShard = data.shardOf(initialPosition);
+    PositionRef initialRef = (PositionRef(discovery.shardSizes[initialShard]++) << shardBits) | initialShard;
+    data.insert(initialShard, initialPosition, initialRef);
+    if (puzzle->isPrimitivePosition(initialPosition)) {
+        discovery.primitives[initialShard].push_back(initialRef);
+    }
+    Frontier frontier(1, FrontierEntry{initialPosition, initialRef});
+
+    while (frontier.size() && !overflow) {
+        /* Phase 1: expand the frontier. */
+        parallelFor(frontier.size(), DISCOVERY_GRAIN,
+                    [&](std::size_t begin, std::size_t end, std::size_t worker) {
+            std::vector<EdgeVector> &buffers = edges[worker];
+            MoveCode *workerMoves = moves.data() + worker * maxMoves;
+            Position *child = scratch[worker];
+            for (std::size_t i = begin; i < end; ++i) {
+                const Position *parent = frontier[i].pos;
+                std::size_t numMoves = puzzle->getMoveCodes(parent, workerMoves);
+                for (std::size_t k = 0; k < numMoves; ++k) {
+                    puzzle->doMove(parent, workerMoves[k], child);
+                    puzzle->canonicalize(child);
+                    buffers[data.shardOf(child)].push_back(Edge{i, workerMoves[k]});
+                }
             }
+        });
+
+        /* Phase 2: merge the edges shard by shard. */
+        parallelFor(numShards, 1, [&](std::size_t begin, std::size_t end, std::size_t worker) {
+            Position *child = scratch[worker];
+            for (std::size_t shard = begin; shard < end; ++shard) {
+                std::vector<Index> &shardEdges = discovery.edges[shard];
+                for (std::vector<EdgeVector> &buffers : edges) {
+                    for (const Edge &edge : buffers[shard]) {
+                        const FrontierEntry &parent = frontier[edge.parent];
+                        puzzle->doMove(parent.pos, edge.move, child);
+                        puzzle->canonicalize(child);
+                        PositionRef childRef;
+                        const PositionRef *ref = data.find(child);
+                        if (ref) {
+                            childRef = *ref;
+                        } else {
+                            childRef = (PositionRef(discovery.shardSizes[shard]++) << shardBits) | shard;
+                            if (childRef > maxRef) {
+                                overflow = true;
+                            }
+                            Position *newPos = child->getCopy();
+                            data.insert(shard, newPos, childRef);
+                            discovered[shard].push_back(FrontierEntry{newPos, childRef});
+                            if (puzzle->isPrimitivePosition(newPos)) {
+                                discovery.primitives[shard].push_back(childRef);
+                            }
+                        }
+                        shardEdges.push_back(static_cast<Index>(childRef));
+                        shardEdges.push_back(static_cast<Index>(parent.ref));
+                    }
+                    buffers[shard].clear();
+                }
+            }
+        });
+
+        if (data.ownsPositions()) {
+            frontier.clear();
+        } else {
+            deleteFrontier(frontier);
         }
-        if (--rem == 0) {
-            rem = numPosNextLevel;
-            numPosNextLevel = 0;
-            ++rmt;
+        for (std::size_t shard = 0; shard < numShards; ++shard) {
+            frontier.insert(frontier.end(), discovered[shard].begin(), discovered[shard].end());
+            discovered[shard].clear();
         }
     }
-    for (Position *pos : closed) {
-        delete pos;
+    if (!data.ownsPositions()) {
+        deleteFrontier(frontier);
     }
-}
-
-void calcRemoteness(SolverData &data, PositionGraph& backwardGraph, const PositionVector &primitives) {
-    for (Position *pos : primitives) {
-        updateRemotenessFrom(data, backwardGraph, pos);
+    for (Position *child : scratch) {
+        delete child;
     }
+    return !overflow;
 }
 
-void updateRemotenessFromMultithreaded(SolverData &data, std::mutex &dataLock,
-                                       PositionGraph& backwardGraph, Position *primitive) {
-    /* Similar logic as in findPrimitives(). */
-    PositionQueue fringe;
-    PositionSet closed;
-    fringe.push(primitive);
-    int rmt = 0;
-    size_t rem = 1;
-    size_t numPosNextLevel = 0;
-
-    while (fringe.size()) {
-        Position *curr_pos = fringe.front();
-        fringe.pop();
-        if (contains(closed, curr_pos)) {
-            delete curr_pos;
-        } else {
-            closed.insert(curr_pos);
-            /* Update remoteness of current position. */
-            dataLock.lock();
-            updateRemoteness(data, curr_pos, rmt);
-            dataLock.unlock();
-            for (Position *next_pos : backwardGraph.at(curr_pos)) {
-                fringe.push(next_pos->getCopy());
-                ++numPosNextLevel;
-            }
-        }
-        if (--rem == 0) {
-            rem = numPosNextLevel;
-            numPosNextLevel = 0;
-            ++rmt;
+/**
+ * @brief Builds the backward graph over dense indices from the edges in
+ * DISCOVERY, releasing the edge lists as it goes.
+ */
+template <class Index>
+void buildBackwardGraph(Discovery<Index> &discovery, const DenseIndex &index, CsrGraph<Index> &graph) {
+    graph.reset(index.size());
+    for (const std::vector<Index> &edges : discovery.edges) {
+        for (std::size_t e = 0; e < edges.size(); e += 2) {
+            graph.countEdge(index(edges[e]));
         }
     }
-    for (Position *pos : closed) {
-        delete pos;
+    graph.allocate();
+    for (std::vector<Index> &edges : discovery.edges) {
+        for (std::size_t e = 0; e < edges.size(); e += 2) {
+            graph.addEdge(index(edges[e]), static_cast<Index>(index(edges[e + 1])));
+        }
+        std::vector<Index>().swap(edges);
     }
+    graph.finish();
 }
 
-void calcRemotenessMultithreaded(SolverData &data, std::mutex &dataLock,
-                                 PositionGraph& backwardGraph, const PositionVector &primitives) {
-    std::vector<std::thread> threads;
-    for (Position *pos : primitives) {
-        threads.emplace_back(updateRemotenessFromMultithreaded, std::ref(data),
-                             std::ref(dataLock), std::ref(backwardGraph), pos);
+/**
+ * @brief Computes the remoteness of every position and stores it in DATA
+ * in place of the position's reference.
+ */
+template <class Index>
+void calcRemoteness(PositionTable &data, Discovery<Index> &discovery, const DenseIndex &index) {
+    CsrGraph<Index> backwardGraph;
+    buildBackwardGraph(discovery, index, backwardGraph);
+
+    /* Multi-source BFS on the backward graph. All primitives are seeded at
+     * remoteness 0, so the first time a position is reached its remoteness
+     * is already the minimum over all primitives and it is never visited
+     * again. Each level is expanded in parallel; a worker claims a parent
+     * by swapping its remoteness from RMT_MAX, so every position enters
+     * the next frontier exactly once. */
+    std::unique_ptr<std::atomic<int>[]> rmts(new std::atomic<int>[index.size()]);
+    for (std::size_t i = 0; i < index.size(); ++i) {
+        rmts[i].store(RMT_MAX, std::memory_order_relaxed);
     }
-    for (std::size_t i = 0; i < threads.size(); ++i) {
-        threads[i].join();
+    std::vector<Index> frontier;
+    for (const std::vector<Index> &primitives : discovery.primitives) {
+        for (Index ref : primitives) {
+            rmts[index(ref)].store(0, std::memory_order_relaxed);
+            frontier.push_back(static_cast<Index>(index(ref)));
+        }
     }
-}
-
-void deallocatePositionVector(const PositionVector &v) {
-    for (Position *pos : v) {
-        delete pos;
+    std::vector<std::vector<Index> > found(numWorkers());
+    for (int rmt = 1; !frontier.empty(); ++rmt) {
+        parallelFor(frontier.size(), RETROGRADE_GRAIN,
+                    [&](std::size_t begin, std::size_t end, std::size_t worker) {
+            std::vector<Index> &buffer = found[worker];
+            for (std::size_t i = begin; i < end; ++i) {
+                for (const Index *parent = backwardGraph.begin(frontier[i]);
+                     parent != backwardGraph.end(frontier[i]); ++parent) {
+                    int expected = RMT_MAX;
+                    if (rmts[*parent].load(std::memory_order_relaxed) == RMT_MAX &&
+                            rmts[*parent].compare_exchange_strong(expected, rmt, std::memory_order_relaxed)) {
+                        buffer.push_back(*parent);
+                    }
+                }
+            }
+        });
+        frontier.clear();
+        for (std::vector<Index> &buffer : found) {
+            frontier.insert(frontier.end(), buffer.begin(), buffer.end());
+            buffer.clear();
+        }
     }
+    backwardGraph.clear();
+
+    /* Replace references in DATA by remoteness. */
+    parallelFor(data.numShards(), 1, [&](std::size_t begin, std::size_t end, std::size_t) {
+        for (std::size_t shard = begin; shard < end; ++shard) {
+            data.forEachInShard(shard, [&](std::uint64_t, PositionTable::Value &value) {
+                value = rmts[index(value)].load(std::memory_order_relaxed);
+            });
+        }
+    });
 }
 
-void deallocatePositionGraph(PositionGraph &graph) {
-    for (auto it = graph.begin(); it != graph.end(); ++it) {
-        deallocatePositionVector(it->second);
-        delete it->first;
+/**
+ * @brief Solves PUZZLE into DATA using INDEX for references and indices.
+ * Returns false and leaves DATA partially filled if INDEX is too narrow.
+ */
+template <class Index>
+bool solveWith(const Puzzle *puzzle, PositionTable &data) {
+    Discovery<Index> discovery;
+
+    /* Step 1: Run BFS from initial position to find all positions and
+     * primitive states, recording every edge of the game graph. */
+    if (!findPrimitives(puzzle, data, discovery)) {
+        return false;
     }
+
+    /* Step 2: Number the positions densely, build the backward graph and
+     * run a single BFS on it starting from all primitive states at once.
+     * The level at which a position is first reached is its remoteness. */
+    DenseIndex index(data.numShardBits(), discovery.shardSizes);
+    calcRemoteness(data, discovery, index);
+    return true;
 }
 }
 
 int Solver::solve() {
     if (!this->solved) {
-        /* Backward graph. */
-        PositionGraph backwardGraph;
-        /* Vector of all primitive states. */
-        PositionVector primitives;
-
-        /* Step 1: Run BFS from initial position to find all primitive states,
-         * constructing the backward graph and initializing solver data in
-         * the meantime. */
-        findPrimitives(this->puzzle, primitives, backwardGraph, this->data);
-
-        /* Step 2: Run BFS from every primitive state, find remoteness of each
-         * position to each primitive state, and take the minimum as the actual
-         * remoteness of the position. */
-//        calcRemoteness(this->data, backwardGraph, primitives);
-        calcRemotenessMultithreaded(this->data, this->dataLock, backwardGraph, primitives);
-
-        /* Step 3: Deallocate backwardGraph. No need to deallocated primitives
-         * as they are already deallocated in Step 2. */
-        deallocatePositionGraph(backwardGraph);
+        /* Use 32-bit references and indices unless there are too many
+         * positions for them. */
+        if (!solveWith<std::uint32_t>(this->puzzle, this->data)) {
+            this->data.clear();
+            solveWith<std::uint64_t>(this->puzzle, this->data);
+        }
+        /* Release the slabs of the frontiers and children. */
+        slabTrim();
 
         this->solved = true;
     }
     /* Retrieve remotenes of the initial position. */
     Position *initPos = this->puzzle->getInitialPosition();
-    int rmt = this->data.find(initPos)->second;
+    int rmt = static_cast<int>(*find(initPos));
     delete initPos;
     return rmt;
 }
@@ -237,46 +352,63 @@ void Solver::printShortestPath(std::ostream &outs) {
         outs << "[NO SOLUTION]" << std::endl;
         return;
     }
+    /* Walk the positions as played, not their canonical forms, so that
+     * the moves printed are the moves of the actual game. */
     Position *currPos = this->puzzle->getInitialPosition();
-    Position *nextPos;
+    Position *nextPos = this->puzzle->getInitialPosition();
+    std::vector<MoveCode> validMoves(this->puzzle->maxMoves());
     while (rmt) {
-        MoveVector validMoves = this->puzzle->getMoves(currPos);
-        for (Move *move : validMoves) {
-            nextPos = this->puzzle->doMove(currPos, move);
-            assert(this->data.find(nextPos) != this->data.end());
-            int nextRmt = this->data.at(nextPos);
+        std::size_t numMoves = this->puzzle->getMoveCodes(currPos, validMoves.data());
+        for (std::size_t i = 0; i < numMoves; ++i) {
+            this->puzzle->doMove(currPos, validMoves[i], nextPos);
+            const PositionTable::Value *nextValue = find(nextPos);
+            assert(nextValue);
+            int nextRmt = static_cast<int>(*nextValue);
             if (nextRmt < rmt) {
-                outs << "[rmt " << rmt << ": " << move->toString() << "]->";
-                delete currPos;
-                currPos = nextPos;
+                outs << "[rmt " << rmt << ": " << this->puzzle->moveString(validMoves[i]) << "]->";
+                std::swap(currPos, nextPos);
                 break;
-            } else {
-                delete nextPos;
             }
         }
         /* We should have found next move, otherwise there is a bug. */
-        for (Move *move : validMoves) {
-            delete move;
-        }
         --rmt;
     }
     delete currPos;
+    delete nextPos;
     outs << "[END]" << std::endl;
 }
 
 void Solver::printInfo(std::ostream &outs, bool binHash) const {
     outs << "Number of positions: " << data.size() << "\n";
     outs << "---------- BEGIN SOLVER DATA ----------\n";
-    for (auto it = this->data.begin(); it != this->data.end(); ++it) {
+    this->data.forEach([&](std::uint64_t hash, PositionTable::Value rmt) {
         if (binHash) {
-            outs << '[' << std::bitset<64>(it->first->hash()) << ": " << it->second << "]\n";
+            outs << '[' << std::bitset<64>(hash) << ": " << rmt << "]\n";
         } else {
-            outs << '[' << it->first->hash() << ": " << it->second << "]\n";
+            outs << '[' << hash << ": " << rmt << "]\n";
         }
-    }
+    });
     outs << "---------- END SOLVER DATA ----------\n";
 }
 
+/**
+ * @brief Returns the stored value of POS, looked up by its canonical form,
+ * or null if POS was not discovered.
+ */
+const PositionTable::Value *Solver::find(const Position *pos) const {
+    /* Only canonical positions are stored, so a position that is found
+     * as it is needs no copy. */
+    const PositionTable::Value *value = this->data.find(pos);
+    if (!value) {
+        Position *key = pos->getCopy();
+        this->puzzle->canonicalize(key);
+        value = this->data.find(key);
+        delete key;
+    }
+    return value;
+}
+
+
 
 
 
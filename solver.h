@@ -1,16 +1,14 @@
 #ifndef SOLVER_H
 #define SOLVER_H
+#include "positiontable.h"
 #include "puzzle.h"
 #include <iostream>
-#include <mutex>
-#include <unordered_map>
 
 class Solver {
 private:
     bool solved;
     Puzzle *puzzle;
-    std::unordered_map<Position *, int, PositionHasher, PositionEqualFn> data;
-    std::mutex dataLock;
+    PositionTable data;
 
 public:
     Solver(const Puzzle *puzzle = nullptr);
@@ -20,6 +18,9 @@ public:
     int solve();
     void printShortestPath(std::ostream &outs);
     void printInfo(std::ostream &outs, bool binHash = false) const;
+
+private:
+    const PositionTable::Value *find(const Position *pos) const;
 };
 
 #endif // SOLVER_H
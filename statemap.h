@@ -0,0 +1,232 @@
+#ifndef STATEMAP_H
+#define STATEMAP_H
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Spreads the bits of a 64-bit state or position hash.
+ * Finalizer of MurmurHash3.
+ */
+inline std::uint64_t mixHash(std::uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/**
+ * @brief Spreads the bits of a 128-bit state, such as a WideMMz state.
+ */
+inline std::uint64_t mixHash(unsigned __int128 h) {
+    return mixHash(static_cast<std::uint64_t>(h) ^ mixHash(static_cast<std::uint64_t>(h >> 64)));
+}
+
+/**
+ * @brief Open-addressing hash map from states of type KEY, 64-bit by
+ * default, to VALUE.
+ *
+ * Keys and values are stored inline in a single power-of-two sized
+ * array and collisions are resolved by linear probing on the mixed
+ * hash. One key value is reserved as the empty slot marker; that key
+ * is stored in a separate slot on the side.
+ */
+template <class Value, class Key = std::uint64_t>
+class StateMap {
+private:
+    const static Key EMPTY = ~Key(0);
+
+    struct Slot {
+        Key key;
+        Value value;
+    };
+
+    std::vector<Slot> slots;
+    std::size_t count;
+    bool hasEmptyKey;
+    Value emptyKeyValue;
+
+public:
+    StateMap(std::size_t capacity = 16);
+
+    std::size_t size() const;
+    std::size_t memoryUsage() const;
+    void clear();
+    void reserve(std::size_t n);
+
+    /**
+     * @brief Returns a pointer to the value of KEY, or nullptr if KEY
+     * is not in the map. The pointer is invalidated by insertions.
+     */
+    Value *find(Key key);
+    const Value *find(Key key) const;
+
+    /**
+     * @brief Inserts (KEY, VALUE) unless KEY is already present. Returns
+     * a pointer to the value stored for KEY and whether it was inserted.
+     */
+    std::pair<Value *, bool> insert(Key key, const Value &value);
+
+    /**
+     * @brief Calls FN(key, value) for every entry in the map.
+     */
+    template <class Fn>
+    void forEach(Fn fn) const;
+
+    /**
+     * @brief Calls FN(key, value) for every entry in the map, where VALUE
+     * is a reference through which the entry may be updated.
+     */
+    template <class Fn>
+    void forEach(Fn fn);
+
+private:
+    std::size_t slotOf(Key key) const;
+    void rehash(std::size_t capacity);
+};
+
+template <class Value, class Key>
+const Key StateMap<Value, Key>::EMPTY;
+
+template <class Value, class Key>
+StateMap<Value, Key>::StateMap(std::size_t capacity) {
+    this->count = 0;
+    this->hasEmptyKey = false;
+    this->emptyKeyValue = Value();
+    rehash(capacity);
+}
+
+template <class Value, class Key>
+std::size_t StateMap<Value, Key>::size() const {
+    return this->count;
+}
+
+/**
+ * @brief Returns the number of bytes held by the slot array.
+ */
+template <class Value, class Key>
+std::size_t StateMap<Value, Key>::memoryUsage() const {
+    return this->slots.capacity() * sizeof(Slot);
+}
+
+template <class Value, class Key>
+void StateMap<Value, Key>::clear() {
+    for (Slot &slot : this->slots) {
+        slot.key = EMPTY;
+    }
+    this->count = 0;
+    this->hasEmptyKey = false;
+}
+
+template <class Value, class Key>
+void StateMap<Value, Key>::reserve(std::size_t n) {
+    /* Keep the load factor at or below 1/2. */
+    if (2 * n > this->slots.size()) {
+        std::size_t capacity = this->slots.size();
+        while (2 * n > capacity) {
+            capacity <<= 1;
+        }
+        rehash(capacity);
+    }
+}
+
+template <class Value, class Key>
+Value *StateMap<Value, Key>::find(Key key) {
+    return const_cast<Value *>(static_cast<const StateMap *>(this)->find(key));
+}
+
+template <class Value, class Key>
+const Value *StateMap<Value, Key>::find(Key key) const {
+    if (key == EMPTY) {
+        return this->hasEmptyKey ? &this->emptyKeyValue : nullptr;
+    }
+    std::size_t mask = this->slots.size() - 1;
+    for (std::size_t i = slotOf(key); ; i = (i + 1) & mask) {
+        if (this->slots[i].key == key) {
+            return &this->slots[i].value;
+        } else if (this->slots[i].key == EMPTY) {
+            return nullptr;
+        }
+    }
+}
+
+template <class Value, class Key>
+std::pair<Value *, bool> StateMap<Value, Key>::insert(Key key, const Value &value) {
+    if (key == EMPTY) {
+        bool inserted = !this->hasEmptyKey;
+        if (inserted) {
+            this->hasEmptyKey = true;
+            this->emptyKeyValue = value;
+            ++this->count;
+        }
+        return std::make_pair(&this->emptyKeyValue, inserted);
+    }
+    reserve(this->count + 1);
+    std::size_t mask = this->slots.size() - 1;
+    for (std::size_t i = slotOf(key); ; i = (i + 1) & mask) {
+        if (this->slots[i].key == key) {
+            return std::make_pair(&this->slots[i].value, false);
+        } else if (this->slots[i].key == EMPTY) {
+            this->slots[i].key = key;
+            this->slots[i].value = value;
+            ++this->count;
+            return std::make_pair(&this->slots[i].value, true);
+        }
+    }
+}
+
+template <class Value, class Key>
+template <class Fn>
+void StateMap<Value, Key>::forEach(Fn fn) const {
+    if (this->hasEmptyKey) {
+        fn(EMPTY, this->emptyKeyValue);
+    }
+    for (const Slot &slot : this->slots) {
+        if (slot.key != EMPTY) {
+            fn(slot.key, slot.value);
+        }
+    }
+}
+
+template <class Value, class Key>
+template <class Fn>
+void StateMap<Value, Key>::forEach(Fn fn) {
+    if (this->hasEmptyKey) {
+        fn(EMPTY, this->emptyKeyValue);
+    }
+    for (Slot &slot : this->slots) {
+        if (slot.key != EMPTY) {
+            fn(slot.key, slot.value);
+        }
+    }
+}
+
+template <class Value, class Key>
+inline std::size_t StateMap<Value, Key>::slotOf(Key key) const {
+    return mixHash(key) & (this->slots.size() - 1);
+}
+
+template <class Value, class Key>
+void StateMap<Value, Key>::rehash(std::size_t capacity) {
+    std::size_t size = 16;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    std::vector<Slot> old(size, Slot{EMPTY, Value()});
+    old.swap(this->slots);
+    std::size_t mask = size - 1;
+    for (const Slot &slot : old) {
+        if (slot.key != EMPTY) {
+            std::size_t i = slotOf(slot.key);
+            while (this->slots[i].key != EMPTY) {
+                i = (i + 1) & mask;
+            }
+            this->slots[i] = slot;
+        }
+    }
+}
+
+#endif // STATEMAP_H
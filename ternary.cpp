@@ -6,6 +6,10 @@ TernaryPosition::TernaryPosition(std::size_t pos) {
 
 TernaryPosition::~TernaryPosition() {}
 
+void TernaryPosition::setPos(std::size_t pos) {
+    this->pos = pos;
+}
+
 std::size_t TernaryPosition::hash() const {
     return this->pos;
 }
@@ -40,12 +44,16 @@ Ternary::Ternary() {}
 
 Ternary::~Ternary(){}
 
+std::string Ternary::moveString(MoveCode move) const {
+    return TernaryMove(move == ROTATE).toString();
+}
+
 Position *Ternary::getInitialPosition() const {
-    return new TernaryPosition;
+    return new TernaryPosition(initialState());
 }
 
 bool Ternary::isPrimitivePosition(const Position *pos) const {
-    return pos->hash() == INIT_POS;
+    return isPrimitiveState(pos->hash());
 }
 
 std::vector<Move *> Ternary::getMoves(const Position *pos) const {
@@ -56,21 +64,15 @@ std::vector<Move *> Ternary::getMoves(const Position *pos) const {
 Position *Ternary::doMove(const Position *pos_, const Move *move_) const {
     const TernaryPosition *pos = static_cast<const TernaryPosition *>(pos_);
     const TernaryMove *move = static_cast<const TernaryMove *>(move_);
-    std::size_t val = pos->hash();
-    if (move->isRotate()) {
-        val <<= 4;
-        val |= (val >> 16);
-        val &= ~(0b1111 << 16);
-    } else {
-        /* Spin */
-        for (int i = 0; i < 3; ++i) {
-            std::size_t num = (val & (0b11 << (i << 2))) >> (i << 2);
-            num = (num + 1) % 3;
-            val &= ~(0b11 << (i << 2));
-            val |= num << (i << 2);
-        }
-    }
-    return new TernaryPosition(val);
+    return new TernaryPosition(applyMove(pos->hash(), move->isRotate() ? ROTATE : SPIN));
+}
+
+std::size_t Ternary::getMoveCodes(const Position *pos, MoveCode *moves) const {
+    return stateMoves(static_cast<const TernaryPosition *>(pos)->hash(), moves);
+}
+
+void Ternary::doMove(const Position *pos, MoveCode move, Position *child) const {
+    static_cast<TernaryPosition *>(child)->setPos(applyMove(static_cast<const TernaryPosition *>(pos)->hash(), move));
 }
 
 Puzzle *Ternary::getCopy() const {
@@ -80,3 +82,11 @@ Puzzle *Ternary::getCopy() const {
 std::size_t Ternary::hashSize() const {
     return 0;
 }
+
+bool Ternary::hasInjectiveHash() const {
+    return true;
+}
+
+std::string Ternary::getId() const {
+    return "ternary";
+}
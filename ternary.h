@@ -10,6 +10,7 @@ private:
 
 public:
     TernaryPosition(std::size_t pos = INIT_POS);
+    void setPos(std::size_t pos);
 
     // Position interface
     virtual ~TernaryPosition() override;
@@ -33,16 +34,74 @@ public:
 
 class Ternary : public Puzzle {
 public:
+    enum PossibleMoves {ROTATE, SPIN};
+
     Ternary();
 
+    // State interface (see valuesolver.h)
+    std::uint64_t initialState() const;
+    bool isPrimitiveState(std::uint64_t state) const;
+    virtual std::size_t maxMoves() const override;
+    std::size_t stateMoves(std::uint64_t state, MoveCode *moves) const;
+    std::uint64_t applyMove(std::uint64_t state, MoveCode move) const;
+    std::uint64_t canonicalState(std::uint64_t state) const;
+    virtual std::string moveString(MoveCode move) const override;
+
     // Puzzle interface
     virtual ~Ternary() override;
     virtual Position *getInitialPosition() const override;
     virtual bool isPrimitivePosition(const Position *pos) const override;
     virtual std::vector<Move *> getMoves(const Position *pos) const override;
     virtual Position *doMove(const Position *pos_, const Move *move_) const override;
+    virtual std::size_t getMoveCodes(const Position *pos, MoveCode *moves) const override;
+    virtual void doMove(const Position *pos, MoveCode move, Position *child) const override;
     virtual Puzzle *getCopy() const override;
     virtual std::size_t hashSize() const override;
+    virtual bool hasInjectiveHash() const override;
+    virtual std::string getId() const override;
 };
 
+inline std::uint64_t Ternary::initialState() const {
+    return INIT_POS;
+}
+
+inline bool Ternary::isPrimitiveState(std::uint64_t state) const {
+    return state == INIT_POS;
+}
+
+inline std::size_t Ternary::maxMoves() const {
+    return 2;
+}
+
+inline std::size_t Ternary::stateMoves(std::uint64_t state, MoveCode *moves) const {
+    (void)state; // unused STATE parameter.
+    moves[0] = ROTATE;
+    moves[1] = SPIN;
+    return 2;
+}
+
+inline std::uint64_t Ternary::applyMove(std::uint64_t state, MoveCode move) const {
+    if (move == ROTATE) {
+        state <<= 4;
+        state |= (state >> 16);
+        state &= ~std::uint64_t(0b1111 << 16);
+    } else {
+        /* Spin */
+        for (int i = 0; i < 3; ++i) {
+            std::uint64_t num = (state & (0b11 << (i << 2))) >> (i << 2);
+            num = (num + 1) % 3;
+            state &= ~std::uint64_t(0b11 << (i << 2));
+            state |= num << (i << 2);
+        }
+    }
+    return state;
+}
+
+/**
+ * @brief Every state is its own canonical state.
+ */
+inline std::uint64_t Ternary::canonicalState(std::uint64_t state) const {
+    return state;
+}
+
 #endif // TERNARY_H
@@ -1,29 +1,39 @@
 #include "toh.h"
+#include <algorithm>
 #include <sstream>
 
 /* class ToHPosition */
 
-ToHPosition::ToHPosition(std::size_t pos) {
-    this->pos = pos;
+ToHPosition::ToHPosition() : rank(0), rodMasks() {}
+
+std::uint64_t ToHPosition::getPos() const {
+    return this->rank;
+}
+
+const std::uint32_t *ToHPosition::getRodMasks() const {
+    return this->rodMasks;
 }
 
-std::size_t ToHPosition::getPos() const {
-    return this->pos;
+void ToHPosition::setPos(std::uint64_t rank, const std::uint32_t *rodMasks) {
+    this->rank = rank;
+    std::copy(rodMasks, rodMasks + ToH::MAX_RODS, this->rodMasks);
 }
 
 ToHPosition::~ToHPosition() {}
 
 std::size_t ToHPosition::hash() const {
-    return this->pos;
+    return this->rank;
 }
 
 bool ToHPosition::operator ==(const Position &other) const {
     const ToHPosition *otherPtr = static_cast<const ToHPosition *>(&other);
-    return this->pos == otherPtr->pos;
+    return this->rank == otherPtr->rank;
 }
 
 Position *ToHPosition::getCopy() const {
-    return new ToHPosition(this->pos);
+    ToHPosition *copy = new ToHPosition;
+    copy->setPos(this->rank, this->rodMasks);
+    return copy;
 }
 
 /* class ToHMove */
@@ -51,102 +61,178 @@ std::string ToHMove::toString() const {
 
 /* class ToH */
 
-ToH::ToH(std::size_t disks, std::size_t rods) {
+namespace {
+const std::size_t MAX_RODS = ToH::MAX_RODS;
+
+/**
+ * @brief Returns true if RODS^DISKS fits in 64 bits, so that every
+ * position has a 64-bit rank.
+ */
+bool ranksFit(std::size_t disks, std::size_t rods) {
+    std::uint64_t power = 1;
+    for (std::size_t i = 0; i < disks; ++i) {
+        if (power > (UINT64_MAX - 1) / rods) {
+            return false;
+        }
+        power *= rods;
+    }
+    return true;
+}
+
+inline MoveCode toMoveCode(std::size_t diskIdx, std::size_t fromRod, std::size_t toRod) {
+    return static_cast<MoveCode>((diskIdx * MAX_RODS + fromRod) * MAX_RODS + toRod);
+}
+
+inline std::size_t diskOf(MoveCode move) {
+    return move / (MAX_RODS * MAX_RODS);
+}
+
+inline std::size_t fromRodOf(MoveCode move) {
+    return move / MAX_RODS % MAX_RODS;
+}
+
+inline std::size_t toRodOf(MoveCode move) {
+    return move % MAX_RODS;
+}
+
+/**
+ * @brief Returns true if disk DISKIDX may be moved from rod FROMROD to
+ * rod TOROD, that is, if it is the smallest disk on FROMROD and TOROD
+ * holds no disk smaller than it.
+ */
+inline bool isValidMove(const std::uint32_t *rodMasks, std::size_t diskIdx,
+                        std::size_t fromRod, std::size_t toRod) {
+    std::uint32_t bit = std::uint32_t(1) << diskIdx;
+    /* Bits of disk DISKIDX and all smaller disks. */
+    std::uint32_t upToDisk = (bit << 1) - 1;
+    return (rodMasks[fromRod] & upToDisk) == bit && !(rodMasks[toRod] & upToDisk);
+}
+
+/**
+ * @brief Writes the codes of all valid moves into MOVES, moving the top
+ * disk of every nonempty rod to every rod whose top disk is larger.
+ */
+std::size_t movesFromMasks(const std::uint32_t *rodMasks, std::size_t rods, MoveCode *moves) {
+    std::size_t numMoves = 0;
+    for (std::size_t i = 0; i < rods; ++i) {
+        if (!rodMasks[i]) {
+            /* Skip current rod if it is empty. */
+            continue;
+        }
+        std::size_t top = __builtin_ctz(rodMasks[i]);
+        std::uint32_t upToTop = (std::uint32_t(2) << top) - 1;
+        for (std::size_t j = 0; j < rods; ++j) {
+            if (!(rodMasks[j] & upToTop)) {
+                moves[numMoves++] = toMoveCode(top, i, j);
+            }
+        }
+    }
+    return numMoves;
+}
+}
+
+ToH::ToH(std::size_t disks, std::size_t rods, bool reduceSymmetry) {
     /* Reset number of disks and rods to default values
      * if either is invalid. */
     if (disks < MIN_DISKS || disks > MAX_DISKS ||
-            rods < MIN_RODS || rods > MAX_RODS) {
+            rods < MIN_RODS || rods > MAX_RODS || !ranksFit(disks, rods)) {
         disks = DEFAULT_DISKS;
         rods = DEFAULT_RODS;
     }
     this->rods = rods;
     this->disks = disks;
+    this->reduceSymmetry = reduceSymmetry;
+    this->powers[0] = 1;
+    for (std::size_t i = 1; i <= MAX_DISKS; ++i) {
+        this->powers[i] = i <= disks ? this->powers[i - 1] * rods : 0;
+    }
 }
 
 ToH::~ToH() {}
 
-Position *ToH::getInitialPosition() const {
+std::uint64_t ToH::initialState() const {
     if (this->rods == 1) {
-        return new ToHPosition(0);
+        return 0;
     }
-    size_t pos = 0;
-    for (size_t i = 0; i < this->disks; ++i) {
-        pos = pos * 10 + 1;
+    /* All disks on rod 1. */
+    std::uint64_t state = 0;
+    for (std::size_t i = 0; i < this->disks; ++i) {
+        state += this->powers[i];
     }
-    return new ToHPosition(pos);
+    return state;
 }
 
-bool ToH::isPrimitivePosition(const Position *pos_) const {
-    const ToHPosition *pos = static_cast<const ToHPosition *>(pos_);
-    return pos->getPos() == 0;
+bool ToH::isPrimitiveState(std::uint64_t state) const {
+    return state == 0;
 }
 
-namespace {
-std::size_t tenToThe(std::size_t power) {
-    std::size_t res = 1;
-    for (size_t i = 0; i < power; ++i) {
-        res *= 10;
-    }
-    return res;
+std::size_t ToH::maxMoves() const {
+    /* The top disk of each of the RODS rods can go to RODS - 1 rods. */
+    return this->rods * (this->rods - 1);
 }
 
-/**
- * @brief Returns the index of the smallest disk on rod ROD.
- * Returns ToH::MAX_DISKS if no disks are on ROD.
- */
-std::size_t smallestDiskOnRod(const ToHPosition *pos, std::size_t rod) {
-    std::size_t diskIdx = 0;
-    for (std::size_t posVal = pos->getPos(); posVal > 0; posVal /= 10) {
-        if (posVal % 10 == rod) {
-            return diskIdx;
+std::size_t ToH::stateMoves(std::uint64_t state, MoveCode *moves) const {
+    std::uint32_t rodMasks[MAX_RODS];
+    unrank(state, rodMasks);
+    return movesFromMasks(rodMasks, this->rods, moves);
+}
+
+std::uint64_t ToH::applyMove(std::uint64_t state, MoveCode move) const {
+    /* Replace digit FROM of the moved disk with digit TO. */
+    std::uint64_t weight = this->powers[diskOf(move)];
+    return state - fromRodOf(move) * weight + toRodOf(move) * weight;
+}
+
+std::uint64_t ToH::canonicalState(std::uint64_t state) const {
+    if (!this->reduceSymmetry) {
+        return state;
+    }
+    /* sortRods() orders rods 1 to RODS - 1 by their largest disk, so a
+     * state is canonical if those rods first appear in increasing order
+     * when its digits are read from the largest disk down. Once rods 1
+     * to RODS - 2 have appeared in order, rod RODS - 1 can only come
+     * next, so most states are settled by their few largest disks
+     * without unranking them. */
+    std::size_t seen[MAX_RODS] = {};
+    std::size_t numSeen = 0;
+    std::uint64_t rest = state;
+    for (std::size_t i = this->disks; i-- > 0 && numSeen + 2 < this->rods;) {
+        std::uint64_t digit = rest / this->powers[i];
+        rest -= digit * this->powers[i];
+        if (digit && !seen[digit]) {
+            seen[digit] = ++numSeen;
+            if (digit != numSeen) {
+                std::uint32_t rodMasks[MAX_RODS];
+                unrank(state, rodMasks);
+                sortRods(rodMasks);
+                return rankOf(rodMasks);
+            }
         }
-        ++diskIdx;
     }
-    return ToH::MAX_DISKS;
+    return state;
 }
 
-std::size_t rodIdxOf(const ToHPosition *pos, std::size_t diskIdx) {
-    std::size_t posVal = pos->getPos();
-    std::size_t shift = tenToThe(diskIdx);
-    return (posVal / shift) % 10;
+std::string ToH::moveString(MoveCode move) const {
+    return ToHMove(diskOf(move), toRodOf(move)).toString();
 }
 
-/**
- * @brief Returns true if MOVE is valid at position POS.
- * A valid Move must satisfy the following two conditions:
- * 1. the disk to move is the smallest on its current rod, and
- * 2. the destination rod must not be holding a disk that is
- * smaller than the disk we are about to move.
- *
- * @param move Move to check for validity.
- * @return True if MOVE is valid, false otherwise.
- */
-bool isValidMove(const ToHPosition *pos, const ToHMove *move) {
-    std::size_t diskIdx = move->getDiskIdx();
-    std::size_t destRod = move->getRodIdx();
-    std::size_t currRod = rodIdxOf(pos, diskIdx);
-    return smallestDiskOnRod(pos, currRod) == diskIdx &&
-            smallestDiskOnRod(pos, destRod) > diskIdx;
+Position *ToH::getInitialPosition() const {
+    ToHPosition *pos = new ToHPosition;
+    unhash(initialState(), pos);
+    return pos;
 }
+
+bool ToH::isPrimitivePosition(const Position *pos_) const {
+    const ToHPosition *pos = static_cast<const ToHPosition *>(pos_);
+    return isPrimitiveState(pos->getPos());
 }
 
 std::vector<Move *> ToH::getMoves(const Position *pos_) const {
     std::vector<Move *> validMoves;
-    const ToHPosition *pos = static_cast<const ToHPosition *>(pos_);
-    for (std::size_t i = 0; i < this->rods; ++i) {
-        std::size_t topDiskIdx = smallestDiskOnRod(pos, i);
-        if (topDiskIdx == this->MAX_DISKS) {
-            /* Skip current rod if it is empty. */
-            continue;
-        }
-        for (std::size_t j = 0; j < this->rods; ++j) {
-            ToHMove *move = new ToHMove(topDiskIdx, j);
-            if (isValidMove(pos, move)) {
-                validMoves.push_back(move);
-            } else {
-                delete move;
-            }
-        }
+    MoveCode moves[MAX_RODS * MAX_RODS];
+    std::size_t numMoves = getMoveCodes(pos_, moves);
+    for (std::size_t i = 0; i < numMoves; ++i) {
+        validMoves.push_back(new ToHMove(diskOf(moves[i]), toRodOf(moves[i])));
     }
     return validMoves;
 }
@@ -154,22 +240,110 @@ std::vector<Move *> ToH::getMoves(const Position *pos_) const {
 Position *ToH::doMove(const Position *pos_, const Move *move_) const {
     const ToHPosition *pos = static_cast<const ToHPosition *>(pos_);
     const ToHMove *move = static_cast<const ToHMove *>(move_);
-    if (isValidMove(pos, move)) {
-        std::size_t posVal = pos->getPos();
-        std::size_t shift = tenToThe(move->getDiskIdx());
-        std::size_t oldDigit = (posVal / shift) % 10;
-        return new ToHPosition(posVal + (move->getRodIdx() - oldDigit) * shift);
-    } else {
+    std::size_t diskIdx = move->getDiskIdx();
+    std::size_t toRod = move->getRodIdx();
+    if (diskIdx >= this->disks || toRod >= this->rods) {
+        return nullptr;
+    }
+    std::size_t fromRod = pos->getPos() / this->powers[diskIdx] % this->rods;
+    if (!isValidMove(pos->getRodMasks(), diskIdx, fromRod, toRod)) {
         return nullptr;
     }
+    ToHPosition *child = new ToHPosition;
+    doMove(pos, toMoveCode(diskIdx, fromRod, toRod), child);
+    return child;
+}
+
+std::size_t ToH::getMoveCodes(const Position *pos, MoveCode *moves) const {
+    return movesFromMasks(static_cast<const ToHPosition *>(pos)->getRodMasks(), this->rods, moves);
+}
+
+void ToH::doMove(const Position *pos_, MoveCode move, Position *child) const {
+    const ToHPosition *pos = static_cast<const ToHPosition *>(pos_);
+    std::uint32_t rodMasks[MAX_RODS];
+    std::copy(pos->getRodMasks(), pos->getRodMasks() + MAX_RODS, rodMasks);
+    std::uint32_t bit = std::uint32_t(1) << diskOf(move);
+    rodMasks[fromRodOf(move)] ^= bit;
+    rodMasks[toRodOf(move)] |= bit;
+    static_cast<ToHPosition *>(child)->setPos(applyMove(pos->getPos(), move), rodMasks);
 }
 
 Puzzle *ToH::getCopy() const {
-    return new ToH(this->disks, this->rods);
+    return new ToH(this->disks, this->rods, this->reduceSymmetry);
 }
 
 std::size_t ToH::hashSize() const {
-    return 0;
+    return this->powers[this->disks];
 }
 
+bool ToH::hasInjectiveHash() const {
+    return true;
+}
+
+bool ToH::isReversible() const {
+    /* A disk can always move back to the rod it came from. */
+    return true;
+}
 
+void ToH::canonicalize(Position *pos_) const {
+    if (!this->reduceSymmetry) {
+        return;
+    }
+    ToHPosition *pos = static_cast<ToHPosition *>(pos_);
+    std::uint32_t rodMasks[MAX_RODS];
+    std::copy(pos->getRodMasks(), pos->getRodMasks() + MAX_RODS, rodMasks);
+    sortRods(rodMasks);
+    pos->setPos(rankOf(rodMasks), rodMasks);
+}
+
+std::string ToH::getId() const {
+    std::stringstream ss;
+    ss << "toh " << this->disks << ' ' << this->rods;
+    return ss.str();
+}
+
+bool ToH::unhash(std::size_t hash, Position *pos) const {
+    std::uint32_t rodMasks[MAX_RODS];
+    unrank(hash, rodMasks);
+    static_cast<ToHPosition *>(pos)->setPos(hash, rodMasks);
+    return true;
+}
+
+/**
+ * @brief Writes the occupancy bitmask of every rod of the position with
+ * rank RANK into RODMASKS, which must have room for MAX_RODS masks.
+ */
+void ToH::unrank(std::uint64_t rank, std::uint32_t *rodMasks) const {
+    std::fill(rodMasks, rodMasks + MAX_RODS, 0);
+    for (std::size_t i = 0; i < this->disks; ++i) {
+        rodMasks[rank % this->rods] |= std::uint32_t(1) << i;
+        rank /= this->rods;
+    }
+}
+
+std::uint64_t ToH::rankOf(const std::uint32_t *rodMasks) const {
+    std::uint64_t rank = 0;
+    for (std::size_t rod = 1; rod < this->rods; ++rod) {
+        for (std::uint32_t mask = rodMasks[rod]; mask; mask &= mask - 1) {
+            rank += rod * this->powers[__builtin_ctz(mask)];
+        }
+    }
+    return rank;
+}
+
+/**
+ * @brief Sorts the masks of rods 1 to RODS - 1 in decreasing order, so
+ * that the rod holding the largest disk off rod 0 comes first. Disks
+ * never share a rod mask bit, so the order is strict between nonempty
+ * rods and the result is the same for every permutation of those rods.
+ */
+void ToH::sortRods(std::uint32_t *rodMasks) const {
+    for (std::size_t i = 2; i < this->rods; ++i) {
+        std::uint32_t mask = rodMasks[i];
+        std::size_t j = i;
+        for (; j > 1 && rodMasks[j - 1] < mask; --j) {
+            rodMasks[j] = rodMasks[j - 1];
+        }
+        rodMasks[j] = mask;
+    }
+}
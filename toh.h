@@ -2,51 +2,6 @@
 #define TOH_H
 #include "puzzle.h"
 
-/**
- * @brief Position of a Towers of Hanoi game.
- *
- * For a game of M rods and N disks:
- *
- * Rods are labeled from 0 to M - 1, where the destination
- * rod is labeled 0, and all other rods are labeled from
- * 1 to M - 1.
- *
- * Disks are labeled from 0 to N - 1 in increasing size
- * order. That is, the smallest disk is labeled 0, and the
- * largest disk is labeled N - 1.
- *
- * Each possible position is uniquely represented by a N-
- * digit integer, where the i-th least significant digit
- * represents the index of the rod where disk i resides.
- * For example, M = 3 and N = 3, the following position
- *    |   |   |
- *    |   |   1
- *    0   |   2
- * ---------------
- * is represented by the integer 001.
- *
- * Limits: 1 <= M <= 10, 1 <= N <= 19.
- * M cannot be greater than 10 because we only have 10 digits
- * 0 through 9 for each rod.
- * N cannot be greater than 19 because we use 64-bit unsigned
- * intergers to represent positions.
- */
-class ToHPosition : public Position {
-private:
-    std::size_t pos;
-
-public:
-    ToHPosition(std::size_t pos = 0);
-
-    std::size_t getPos() const;
-
-    // Position interface
-    virtual ~ToHPosition() override;
-    virtual std::size_t hash() const override;
-    virtual bool operator ==(const Position &other) const override;
-    virtual Position *getCopy() const override;
-};
-
 /**
  * @brief Defines a move in a Towers of Hanoi game.
  * Moves disk with index RODIDX to rod with index
@@ -70,22 +25,41 @@ public:
 
 /**
  * @brief A Towers of Hanoi game instance.
+ *
+ * Rods 1 to M - 1 are interchangeable: permuting them maps positions
+ * to positions of the same remoteness. Unless REDUCESYMMETRY is false,
+ * canonicalize() orders those rods by decreasing occupancy bitmask, so
+ * Solver explores up to (M - 1)! times fewer positions.
  */
 class ToH : public Puzzle {
 public:
     const static std::size_t MIN_RODS = 1;
     const static std::size_t MIN_DISKS = 1;
     const static std::size_t MAX_RODS = 10;
-    const static std::size_t MAX_DISKS = 19;
+    const static std::size_t MAX_DISKS = 32;
     const static std::size_t DEFAULT_RODS = 3;
     const static std::size_t DEFAULT_DISKS = 3;
 
 private:
     std::size_t rods;
     std::size_t disks;
+    /* POWERS[i] is RODS^i, the weight of disk i in a rank. */
+    std::uint64_t powers[MAX_DISKS + 1];
+    bool reduceSymmetry;
 
 public:
-    ToH(std::size_t disks = DEFAULT_DISKS, std::size_t rods = DEFAULT_RODS);
+    ToH(std::size_t disks = DEFAULT_DISKS, std::size_t rods = DEFAULT_RODS, bool reduceSymmetry = true);
+
+    // State interface (see valuesolver.h), with ranks as states.
+    // The move code of moving disk d from rod f to rod t is
+    // (d * MAX_RODS + f) * MAX_RODS + t.
+    std::uint64_t initialState() const;
+    bool isPrimitiveState(std::uint64_t state) const;
+    virtual std::size_t maxMoves() const override;
+    std::size_t stateMoves(std::uint64_t state, MoveCode *moves) const;
+    std::uint64_t applyMove(std::uint64_t state, MoveCode move) const;
+    std::uint64_t canonicalState(std::uint64_t state) const;
+    virtual std::string moveString(MoveCode move) const override;
 
     // Puzzle interface
     virtual ~ToH() override;
@@ -93,8 +67,69 @@ public:
     virtual bool isPrimitivePosition(const Position *pos_) const override;
     virtual std::vector<Move *> getMoves(const Position *pos_) const override;
     virtual Position *doMove(const Position *pos_, const Move *move_) const override;
+    virtual std::size_t getMoveCodes(const Position *pos, MoveCode *moves) const override;
+    virtual void doMove(const Position *pos, MoveCode move, Position *child) const override;
     virtual Puzzle *getCopy() const override;
     virtual std::size_t hashSize() const override;
+    virtual bool hasInjectiveHash() const override;
+    virtual bool isReversible() const override;
+    virtual void canonicalize(Position *pos) const override;
+    virtual std::string getId() const override;
+    virtual bool unhash(std::size_t hash, Position *pos) const override;
+
+private:
+    void unrank(std::uint64_t rank, std::uint32_t *rodMasks) const;
+    std::uint64_t rankOf(const std::uint32_t *rodMasks) const;
+    void sortRods(std::uint32_t *rodMasks) const;
+};
+
+/**
+ * @brief Position of a Towers of Hanoi game.
+ *
+ * For a game of M rods and N disks:
+ *
+ * Rods are labeled from 0 to M - 1, where the destination
+ * rod is labeled 0, and all other rods are labeled from
+ * 1 to M - 1.
+ *
+ * Disks are labeled from 0 to N - 1 in increasing size
+ * order. That is, the smallest disk is labeled 0, and the
+ * largest disk is labeled N - 1.
+ *
+ * A position keeps one occupancy bitmask per rod, where bit i
+ * of the mask of rod r is set if disk i resides on rod r, so
+ * the top disk of a rod is the lowest set bit of its mask.
+ *
+ * Each possible position is also uniquely represented by its
+ * rank, the N-digit base-M integer whose i-th least significant
+ * digit is the index of the rod where disk i resides. Ranks
+ * range from 0 to M^N - 1 and serve as hashes. For example,
+ * M = 3 and N = 3, the following position
+ *    |   |   |
+ *    |   |   1
+ *    0   |   2
+ * ---------------
+ * has rank 001 in base 3, that is 1.
+ *
+ * Limits: 1 <= M <= 10, 1 <= N <= 32, M^N < 2^64.
+ */
+class ToHPosition : public Position {
+private:
+    std::uint64_t rank;
+    std::uint32_t rodMasks[ToH::MAX_RODS];
+
+public:
+    ToHPosition();
+
+    std::uint64_t getPos() const;
+    const std::uint32_t *getRodMasks() const;
+    void setPos(std::uint64_t rank, const std::uint32_t *rodMasks);
+
+    // Position interface
+    virtual ~ToHPosition() override;
+    virtual std::size_t hash() const override;
+    virtual bool operator ==(const Position &other) const override;
+    virtual Position *getCopy() const override;
 };
 
 #endif // TOH_H
@@ -0,0 +1,129 @@
+#include "tohsolver.h"
+#include <algorithm>
+
+namespace {
+const std::uint64_t SATURATED = UINT64_MAX;
+
+inline std::uint64_t saturatingAdd(std::uint64_t a, std::uint64_t b) {
+    return a > SATURATED - b ? SATURATED : a + b;
+}
+}
+
+/* class ToHSolver */
+
+ToHSolver::ToHSolver(std::size_t disks, std::size_t rods) : disks(disks) {
+    /* With DISKS + 1 rods, every disk but the largest can be parked on
+     * a spare rod of its own, which takes the fewest moves possible, so
+     * further rods are of no use and are left out of the tables and the
+     * rod masks. */
+    rods = std::min(rods, disks + 1);
+    this->rods = rods;
+    if (rods < 3 || rods > MAX_RODS) {
+        return;
+    }
+    this->moveCounts.assign(rods + 1, std::vector<std::uint64_t>());
+    this->splits.assign(rods + 1, std::vector<std::size_t>());
+    /* Three rods: park all but the largest disk. */
+    std::vector<std::uint64_t> &three = this->moveCounts[3];
+    three.assign(disks + 1, 0);
+    this->splits[3].assign(disks + 1, 0);
+    for (std::size_t n = 1; n <= disks; ++n) {
+        three[n] = saturatingAdd(saturatingAdd(three[n - 1], three[n - 1]), 1);
+        this->splits[3][n] = n - 1;
+    }
+    for (std::size_t k = 4; k <= rods; ++k) {
+        const std::vector<std::uint64_t> &fewer = this->moveCounts[k - 1];
+        std::vector<std::uint64_t> &counts = this->moveCounts[k];
+        std::vector<std::size_t> &split = this->splits[k];
+        counts.assign(disks + 1, 0);
+        split.assign(disks + 1, 0);
+        if (disks >= 1) {
+            counts[1] = 1;
+        }
+        for (std::size_t n = 2; n <= disks; ++n) {
+            counts[n] = SATURATED;
+            split[n] = n - 1;
+            for (std::size_t t = 1; t < n; ++t) {
+                std::uint64_t count = saturatingAdd(saturatingAdd(counts[t], counts[t]), fewer[n - t]);
+                if (count < counts[n]) {
+                    counts[n] = count;
+                    split[n] = t;
+                }
+            }
+        }
+    }
+}
+
+bool ToHSolver::isSolvable() const {
+    /* A single rod is already solved, and two rods can only move one disk. */
+    return this->rods <= MAX_RODS && (this->rods == 1 || this->rods >= 3 || this->disks <= 1);
+}
+
+bool ToHSolver::minMoves(std::uint64_t &count) const {
+    if (!isSolvable()) {
+        return false;
+    }
+    if (this->rods < 3) {
+        count = this->rods == 1 ? 0 : this->disks;
+        return true;
+    }
+    if (this->moveCounts[this->rods][this->disks] == SATURATED) {
+        return false;
+    }
+    count = this->moveCounts[this->rods][this->disks];
+    return true;
+}
+
+ToHSolver::MoveStream ToHSolver::moves() const {
+    return MoveStream(this);
+}
+
+/* class ToHSolver::MoveStream */
+
+ToHSolver::MoveStream::MoveStream(const ToHSolver *solver) : solver(solver) {
+    if (solver->rods >= 2 && solver->isSolvable() && solver->disks > 0) {
+        /* Shifting by 64 is undefined, so fill the mask from the top. */
+        std::uint64_t allRods = ~std::uint64_t(0) >> (64 - solver->rods);
+        this->stack.push_back(Frame{0, solver->disks, 1, 0, allRods, 0, 0});
+    }
+}
+
+bool ToHSolver::MoveStream::next(std::size_t &diskIdx, std::size_t &fromRod, std::size_t &toRod) {
+    /* Depth-first walk of the recursion. Each frame moves a stack of disks
+     * in three steps: park its top disks on a spare rod, move the rest
+     * with one rod fewer, then bring the parked disks back. */
+    while (!this->stack.empty()) {
+        Frame &frame = this->stack.back();
+        if (frame.disks == 1) {
+            diskIdx = frame.base;
+            fromRod = frame.from;
+            toRod = frame.to;
+            this->stack.pop_back();
+            return true;
+        }
+        std::size_t numRods = __builtin_popcountll(frame.rods);
+        std::size_t parked = this->solver->splits[numRods][frame.disks];
+        Frame child;
+        switch (frame.stage++) {
+        case 0: {
+            std::uint64_t spares = frame.rods & ~(std::uint64_t(1) << frame.from) & ~(std::uint64_t(1) << frame.to);
+            frame.spare = __builtin_ctzll(spares);
+            child = Frame{frame.base, parked, frame.from, frame.spare, frame.rods, 0, 0};
+            break;
+        }
+        case 1:
+            child = Frame{frame.base + parked, frame.disks - parked, frame.from, frame.to,
+                          frame.rods & ~(std::uint64_t(1) << frame.spare), 0, 0};
+            break;
+        case 2:
+            child = Frame{frame.base, parked, frame.spare, frame.to, frame.rods, 0, 0};
+            break;
+        default:
+            this->stack.pop_back();
+            continue;
+        }
+        /* FRAME may be invalidated by the push. */
+        this->stack.push_back(child);
+    }
+    return false;
+}
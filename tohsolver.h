@@ -0,0 +1,83 @@
+#ifndef TOHSOLVER_H
+#define TOHSOLVER_H
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Solves the standard Towers of Hanoi game of ToH, moving all
+ * disks from rod 1 to rod 0, without searching the game graph.
+ *
+ * Three rods are solved by the classic recursion in 2^N - 1 moves. More
+ * rods use the Frame-Stewart recursion: park the top T disks on a spare
+ * rod using all rods, move the remaining N - T disks with one rod fewer,
+ * then bring the T disks back on top. The best T for every N and number
+ * of rods is found once by dynamic programming. Frame-Stewart is optimal
+ * for three and four rods and conjectured optimal beyond.
+ *
+ * Move sequences are produced lazily by a MoveStream whose memory is
+ * linear in the number of disks, so games of hundreds of disks can be
+ * played out move by move.
+ */
+class ToHSolver {
+public:
+    /* Largest number of rods of use that fits in the rod masks. Games
+     * with more disks than that and more rods are not supported, and
+     * isSolvable() returns false for them. */
+    const static std::size_t MAX_RODS = 64;
+
+    /**
+     * @brief Lazy sequence of the moves of an optimal solution.
+     */
+    class MoveStream {
+    private:
+        struct Frame {
+            /* Move disks BASE to BASE + DISKS - 1 from rod FROM to rod TO
+             * using the rods in RODS. */
+            std::size_t base;
+            std::size_t disks;
+            std::size_t from;
+            std::size_t to;
+            std::uint64_t rods;
+            std::size_t spare;
+            int stage;
+        };
+        const ToHSolver *solver;
+        std::vector<Frame> stack;
+
+    public:
+        MoveStream(const ToHSolver *solver);
+
+        /**
+         * @brief Writes the next move into DISKIDX, FROMROD and TOROD and
+         * returns true, or returns false once all moves were made.
+         */
+        bool next(std::size_t &diskIdx, std::size_t &fromRod, std::size_t &toRod);
+    };
+
+private:
+    std::size_t disks;
+    /* Number of rods of use, at most DISKS + 1. */
+    std::size_t rods;
+    /* MOVECOUNTS[k][n] is the number of moves needed for n disks and k
+     * rods, saturated at UINT64_MAX, and SPLITS[k][n] is the number of
+     * disks parked in the first step. Indexed from k = 3. */
+    std::vector<std::vector<std::uint64_t> > moveCounts;
+    std::vector<std::vector<std::size_t> > splits;
+
+public:
+    ToHSolver(std::size_t disks, std::size_t rods);
+
+    bool isSolvable() const;
+
+    /**
+     * @brief Writes the minimum number of moves into COUNT and returns
+     * true. Returns false if the game is unsolvable or the number does not
+     * fit in 64 bits.
+     */
+    bool minMoves(std::uint64_t &count) const;
+
+    MoveStream moves() const;
+};
+
+#endif // TOHSOLVER_H
@@ -0,0 +1,416 @@
+#ifndef VALUESOLVER_H
+#define VALUESOLVER_H
+#include "csrgraph.h"
+#include "move.h"
+#include "statemap.h"
+#include <bitset>
+#include <climits>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Writes STATE to OUTS in decimal, or as 64 binary digits if
+ * BINARY is true.
+ */
+inline void printState(std::ostream &outs, std::uint64_t state, bool binary) {
+    if (binary) {
+        outs << std::bitset<64>(state);
+    } else {
+        outs << state;
+    }
+}
+
+/**
+ * @brief Writes the 128-bit STATE to OUTS in decimal, or as 128 binary
+ * digits if BINARY is true.
+ */
+inline void printState(std::ostream &outs, unsigned __int128 state, bool binary) {
+    if (binary) {
+        outs << std::bitset<64>(static_cast<std::uint64_t>(state >> 64))
+             << std::bitset<64>(static_cast<std::uint64_t>(state));
+        return;
+    }
+    char digits[40];
+    char *p = digits + sizeof(digits);
+    *--p = '\0';
+    do {
+        *--p = static_cast<char>('0' + state % 10);
+        state /= 10;
+    } while (state);
+    outs << p;
+}
+
+/**
+ * @brief Solver specialised at compile time for a puzzle whose positions
+ * are packed into integer states.
+ *
+ * Unlike Solver, positions are plain integers and moves are generated
+ * through non-virtual calls, so expanding a position does not allocate
+ * or go through a vtable. PUZZLETYPE must provide the state interface
+ * that all puzzles in this project implement next to the Puzzle
+ * interface, where State is the type returned by initialState(), either
+ * std::uint64_t or, for WideMMz, a 128-bit integer:
+ *
+ *     State initialState() const;
+ *     bool isPrimitiveState(State state) const;
+ *     std::size_t maxMoves() const;
+ *     std::size_t stateMoves(State state, MoveCode *moves) const;
+ *     State applyMove(State state, MoveCode move) const;
+ *     State canonicalState(State state) const;
+ *     std::string moveString(MoveCode move) const;
+ *
+ * stateMoves() writes the codes of all valid moves at STATE into MOVES,
+ * which has room for maxMoves() codes, and returns how many it wrote.
+ * canonicalState() is the state counterpart of Puzzle::canonicalize();
+ * only canonical states are stored. States need not equal the
+ * Position::hash() of their positions: MMz states are packed positions,
+ * while MMz hashes are their ranks.
+ *
+ * A memory limit may be set with setMemoryLimit(). The solver tracks the
+ * bytes held by its tables while solving and gives up once they exceed
+ * the limit. It also gives up once more states are reachable than its
+ * 32-bit indices can number.
+ *
+ * A solver may be reused for another puzzle with reset(). Solvers that
+ * are reused for many small puzzles can keep their buffers between
+ * solves with setKeepBuffers(true), so that solving does not allocate
+ * once the buffers have grown to fit.
+ */
+template <class PuzzleType>
+class ValueSolver {
+public:
+    typedef decltype(std::declval<const PuzzleType &>().initialState()) State;
+    const static int RMT_MAX = INT_MAX;
+
+private:
+    bool solved;
+    PuzzleType puzzle;
+    /* Dense index of every discovered state. */
+    StateMap<std::uint32_t, State> index;
+    std::vector<State> states;
+    std::vector<int> rmts;
+    std::size_t primitives;
+    /* Memory limit in bytes, or 0 if there is none. */
+    std::size_t memoryLimit;
+    std::size_t peakMemory;
+
+    /* Scratch buffers of solve(). */
+    struct Buffers {
+        /* (child, parent) index pairs of every edge. */
+        std::vector<std::uint32_t> edges;
+        /* Whether each state has a move. */
+        std::vector<bool> hasMoves;
+        /* Whether edges into each state are kept. */
+        std::vector<bool> keep;
+        CsrGraph<std::uint32_t> backwardGraph;
+        std::vector<std::uint32_t> frontier;
+        std::vector<std::uint32_t> next;
+    };
+    Buffers buffers;
+    bool keepBuffers;
+
+public:
+    ValueSolver(const PuzzleType &puzzle);
+
+    void reset(const PuzzleType &puzzle);
+    void setMemoryLimit(std::size_t bytes);
+    void setKeepBuffers(bool keep);
+    int solve();
+    int remoteness(State state);
+    std::size_t numPositions() const;
+    std::size_t numPrimitives() const;
+    std::size_t peakMemoryUsage() const;
+    void printShortestPath(std::ostream &outs);
+    void printInfo(std::ostream &outs, bool binHash = false) const;
+
+private:
+    bool trackMemory(std::size_t bytes);
+    void release();
+    template <class Buffer>
+    void freeBuffer(Buffer &buffer);
+};
+
+template <class PuzzleType>
+const int ValueSolver<PuzzleType>::RMT_MAX;
+
+template <class PuzzleType>
+ValueSolver<PuzzleType>::ValueSolver(const PuzzleType &puzzle) : puzzle(puzzle) {
+    this->solved = false;
+    this->primitives = 0;
+    this->memoryLimit = 0;
+    this->peakMemory = 0;
+    this->keepBuffers = false;
+}
+
+/**
+ * @brief Makes the solver solve PUZZLE from scratch on the next call to
+ * solve(). Limits and buffers are kept.
+ */
+template <class PuzzleType>
+void ValueSolver<PuzzleType>::reset(const PuzzleType &puzzle) {
+    this->puzzle = puzzle;
+    this->solved = false;
+}
+
+/**
+ * @brief Makes solve() give up once the tables of the solver take more
+ * than BYTES bytes. A limit of 0 removes the limit.
+ */
+template <class PuzzleType>
+void ValueSolver<PuzzleType>::setMemoryLimit(std::size_t bytes) {
+    this->memoryLimit = bytes;
+}
+
+/**
+ * @brief Makes solve() keep its buffers for the next puzzle if KEEP is
+ * true, rather than freeing them as soon as it is done with them.
+ */
+template <class PuzzleType>
+void ValueSolver<PuzzleType>::setKeepBuffers(bool keep) {
+    this->keepBuffers = keep;
+}
+
+/**
+ * @brief Returns the remoteness of the initial state, RMT_MAX if it cannot
+ * reach a primitive state, or -1 if the memory limit was exceeded or more
+ * than UINT32_MAX + 1 states are reachable.
+ */
+template <class PuzzleType>
+int ValueSolver<PuzzleType>::solve() {
+    if (!this->solved) {
+        if (this->keepBuffers) {
+            this->index.clear();
+            this->states.clear();
+            this->primitives = 0;
+        } else {
+            release();
+        }
+        this->peakMemory = 0;
+        std::vector<MoveCode> moves(this->puzzle.maxMoves());
+        std::vector<std::uint32_t> &edges = this->buffers.edges;
+        std::vector<bool> &hasMoves = this->buffers.hasMoves;
+        edges.clear();
+        hasMoves.clear();
+
+        /* Step 1: BFS from the initial state. STATES doubles as the queue:
+         * states are numbered in the order they are discovered. */
+        State initialState = this->puzzle.canonicalState(this->puzzle.initialState());
+        this->index.insert(initialState, 0);
+        this->states.push_back(initialState);
+        for (std::size_t i = 0; i < this->states.size(); ++i) {
+            if (!trackMemory(edges.capacity() * sizeof(std::uint32_t) + hasMoves.capacity() / CHAR_BIT)) {
+                return -1;
+            }
+            State state = this->states[i];
+            std::size_t numMoves = this->puzzle.stateMoves(state, moves.data());
+            hasMoves.push_back(numMoves != 0);
+            for (std::size_t k = 0; k < numMoves; ++k) {
+                State child = this->puzzle.canonicalState(this->puzzle.applyMove(state, moves[k]));
+                std::size_t numStates = this->states.size();
+                std::uint32_t childIdx = static_cast<std::uint32_t>(numStates);
+                std::pair<std::uint32_t *, bool> res = this->index.insert(child, childIdx);
+                if (res.second) {
+                    if (numStates > UINT32_MAX) {
+                        /* The index of CHILD does not fit in the tables. */
+                        release();
+                        return -1;
+                    }
+                    this->states.push_back(child);
+                } else {
+                    childIdx = *res.first;
+                }
+                edges.push_back(childIdx);
+                edges.push_back(static_cast<std::uint32_t>(i));
+            }
+        }
+        std::size_t numStates = this->states.size();
+
+        /* Step 2: Build the backward graph. A non-primitive state without
+         * moves never gets a remoteness, so edges into it are left out. */
+        std::vector<bool> &keep = this->buffers.keep;
+        keep.assign(numStates, false);
+        for (std::size_t i = 0; i < numStates; ++i) {
+            keep[i] = hasMoves[i] || this->puzzle.isPrimitiveState(this->states[i]);
+        }
+        freeBuffer(hasMoves);
+        CsrGraph<std::uint32_t> &backwardGraph = this->buffers.backwardGraph;
+        backwardGraph.reset(numStates);
+        for (std::size_t e = 0; e < edges.size(); e += 2) {
+            if (keep[edges[e]]) {
+                backwardGraph.countEdge(edges[e]);
+            }
+        }
+        backwardGraph.allocate();
+        if (!trackMemory(edges.capacity() * sizeof(std::uint32_t) + keep.capacity() / CHAR_BIT +
+                         (backwardGraph.numNodes() + 1) * sizeof(std::size_t) +
+                         backwardGraph.numEdges() * sizeof(std::uint32_t))) {
+            return -1;
+        }
+        for (std::size_t e = 0; e < edges.size(); e += 2) {
+            if (keep[edges[e]]) {
+                backwardGraph.addEdge(edges[e], edges[e + 1]);
+            }
+        }
+        backwardGraph.finish();
+        freeBuffer(edges);
+        freeBuffer(keep);
+
+        /* Step 3: Multi-source BFS on the backward graph from all primitive
+         * states at once. */
+        this->rmts.assign(numStates, RMT_MAX);
+        std::vector<std::uint32_t> &frontier = this->buffers.frontier;
+        frontier.clear();
+        for (std::size_t i = 0; i < numStates; ++i) {
+            if (this->puzzle.isPrimitiveState(this->states[i])) {
+                this->rmts[i] = 0;
+                frontier.push_back(static_cast<std::uint32_t>(i));
+            }
+        }
+        this->primitives = frontier.size();
+        std::vector<std::uint32_t> &next = this->buffers.next;
+        next.clear();
+        for (int rmt = 1; !frontier.empty(); ++rmt) {
+            if (!trackMemory((backwardGraph.numNodes() + 1) * sizeof(std::size_t) +
+                             backwardGraph.numEdges() * sizeof(std::uint32_t) +
+                             (frontier.capacity() + next.capacity()) * sizeof(std::uint32_t))) {
+                return -1;
+            }
+            for (std::uint32_t child : frontier) {
+                for (const std::uint32_t *parent = backwardGraph.begin(child);
+                     parent != backwardGraph.end(child); ++parent) {
+                    if (this->rmts[*parent] == RMT_MAX) {
+                        this->rmts[*parent] = rmt;
+                        next.push_back(*parent);
+                    }
+                }
+            }
+            frontier.swap(next);
+            next.clear();
+        }
+        freeBuffer(backwardGraph);
+        freeBuffer(frontier);
+        freeBuffer(next);
+        this->solved = true;
+    }
+    return this->rmts[0];
+}
+
+/**
+ * @brief Returns the remoteness of STATE, or RMT_MAX if STATE cannot
+ * reach a primitive state or is not reachable from the initial state.
+ */
+template <class PuzzleType>
+int ValueSolver<PuzzleType>::remoteness(State state) {
+    if (solve() < 0) {
+        return RMT_MAX;
+    }
+    const std::uint32_t *idx = this->index.find(this->puzzle.canonicalState(state));
+    return idx ? this->rmts[*idx] : RMT_MAX;
+}
+
+template <class PuzzleType>
+std::size_t ValueSolver<PuzzleType>::numPositions() const {
+    return this->states.size();
+}
+
+/**
+ * @brief Returns the number of primitive states reachable from the
+ * initial state.
+ */
+template <class PuzzleType>
+std::size_t ValueSolver<PuzzleType>::numPrimitives() const {
+    return this->primitives;
+}
+
+/**
+ * @brief Returns the largest number of bytes the tables of the solver
+ * took during the last call to solve() that did work.
+ */
+template <class PuzzleType>
+std::size_t ValueSolver<PuzzleType>::peakMemoryUsage() const {
+    return this->peakMemory;
+}
+
+template <class PuzzleType>
+void ValueSolver<PuzzleType>::printShortestPath(std::ostream &outs) {
+    int rmt = solve();
+    if (rmt < 0) {
+        outs << "[MEMORY LIMIT EXCEEDED]" << std::endl;
+        return;
+    } else if (rmt == RMT_MAX) {
+        outs << "[NO SOLUTION]" << std::endl;
+        return;
+    }
+    std::vector<MoveCode> moves(this->puzzle.maxMoves());
+    /* Follow the states as played; remoteness() canonicalizes them. */
+    State state = this->puzzle.initialState();
+    while (rmt) {
+        std::size_t numMoves = this->puzzle.stateMoves(state, moves.data());
+        for (std::size_t k = 0; k < numMoves; ++k) {
+            State child = this->puzzle.applyMove(state, moves[k]);
+            if (remoteness(child) < rmt) {
+                outs << "[rmt " << rmt << ": " << this->puzzle.moveString(moves[k]) << "]->";
+                state = child;
+                break;
+            }
+        }
+        /* We should have found next move, otherwise there is a bug. */
+        --rmt;
+    }
+    outs << "[END]" << std::endl;
+}
+
+template <class PuzzleType>
+void ValueSolver<PuzzleType>::printInfo(std::ostream &outs, bool binHash) const {
+    outs << "Number of positions: " << this->states.size() << "\n";
+    outs << "---------- BEGIN SOLVER DATA ----------\n";
+    for (std::size_t i = 0; i < this->states.size(); ++i) {
+        outs << '[';
+        printState(outs, this->states[i], binHash);
+        outs << ": " << this->rmts[i] << "]\n";
+    }
+    outs << "---------- END SOLVER DATA ----------\n";
+}
+
+/**
+ * @brief Records that the solver holds BYTES bytes next to its state
+ * tables. Returns false and releases all tables if the total exceeds the
+ * memory limit.
+ */
+template <class PuzzleType>
+bool ValueSolver<PuzzleType>::trackMemory(std::size_t bytes) {
+    bytes += this->index.memoryUsage() +
+            this->states.capacity() * sizeof(State) +
+            this->rmts.capacity() * sizeof(int);
+    if (bytes > this->peakMemory) {
+        this->peakMemory = bytes;
+    }
+    if (this->memoryLimit && bytes > this->memoryLimit) {
+        release();
+        return false;
+    }
+    return true;
+}
+
+template <class PuzzleType>
+void ValueSolver<PuzzleType>::release() {
+    this->index = StateMap<std::uint32_t, State>();
+    std::vector<State>().swap(this->states);
+    std::vector<int>().swap(this->rmts);
+    this->primitives = 0;
+    this->buffers = Buffers();
+}
+
+/**
+ * @brief Frees BUFFER unless buffers are kept for the next puzzle.
+ */
+template <class PuzzleType>
+template <class Buffer>
+void ValueSolver<PuzzleType>::freeBuffer(Buffer &buffer) {
+    if (!this->keepBuffers) {
+        buffer = Buffer();
+    }
+}
+
+#endif // VALUESOLVER_H